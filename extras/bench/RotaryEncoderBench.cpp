@@ -0,0 +1,806 @@
+/*! @file RotaryEncoderBench.cpp
+
+@section RotaryEncoderBench_section Description
+
+Host benchmark and regression test of the RotaryEncoder library. The library is compiled natively
+against the simulation of "RotaryEncoderSim.h" and fed with generated quadrature and pushbutton
+waveforms through EncoderSimulator::Replay(), which calls the pin interrupt handlers and the timer
+tick just as the hardware would. All waveforms are generated from fixed parameters, so every run
+decodes exactly the same edges and only the timings differ between computers. The program reports:
+
+- the decoded steps and button presses against the expected ones, with contact bounce of 0 to 8
+  pulses injected before every edge, in interrupt and in polling mode and for a pushbutton on a pin
+  without an interrupt, which is sampled on the timer tick
+- the events of the button gesture recognizer for clicks, double clicks and long presses with and
+  without repeats
+- the number of flashes and the end color of keyframe animations with counted loops, a loop
+  without end and an animation started by an event while the event buffer is full
+- the positions decoded by an EncoderScanner with 4 encoders on one port turned at the same time
+- the time per edge of the rotate interrupt of EncoderClass and of the RotaryEncoder template and
+  per timer tick, idle and while fading, in nanoseconds and, on x86 processors, in time stamp
+  counter cycles
+- the time per edge of the digitalRead() and if-chain decoder of library version 1.0.6 against the
+  direct port read and table decoder which replaced it, and the time saved per edge. The simulated
+  digitalRead() is a plain array access, on an AVR it takes about 50 cycles more, so the saving
+  on the hardware is larger than the one measured here.
+
+With "--check" the program returns 1 if any decoded count is wrong, which is how it is run as a
+test. Build it with the CMakeLists.txt of this directory:
+
+    cmake -S extras/bench -B build && cmake --build build && ctest --test-dir build
+    build/RotaryEncoderBench
+
+@section RotaryEncoderBench_license License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+
+@section RotaryEncoderBench_versions Changelog
+
+| Version | Date       | Developer  | Comments
+| ------- | ---------- |------------| --------------------------------------------------------------
+| 1.0.6   | 2026-10-16 | SV-Zanshin | EEPROM power cut case
+| 1.0.5   | 2026-10-16 | SV-Zanshin | Detent and range cases, counter build
+| 1.0.4   | 2026-10-16 | SV-Zanshin | Keyframe animation cases
+| 1.0.3   | 2026-10-16 | SV-Zanshin | Button gesture cases
+| 1.0.2   | 2026-10-16 | SV-Zanshin | Multi-lane EncoderScanner case
+| 1.0.1   | 2026-10-16 | SV-Zanshin | Sampled pushbutton and RotaryEncoder template cases
+| 1.0.0   | 2026-10-16 | SV-Zanshin | Initial coding
+
+*/
+#include <stdio.h>          // printf()
+#include <string.h>         // strcmp()
+#include <chrono>           // Host clock for the timings
+#include "RotaryEncoder.h"  // Library under test
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>  // __rdtsc()
+  #define BENCH_CYCLES __rdtsc()  ///< Time stamp counter
+#endif
+
+const uint8_t  kLeft      = 2;       ///< Simulated left encoder pin
+const uint8_t  kRight     = 3;       ///< Simulated right encoder pin
+const uint8_t  kButton    = 4;       ///< Simulated pushbutton pin
+const uint8_t  kLeftT     = 5;       ///< Left pin of the RotaryEncoder template instance
+const uint8_t  kRightT    = 6;       ///< Right pin of the RotaryEncoder template instance
+const uint8_t  kSampled   = 24;      ///< Pushbutton pin without an interrupt
+const uint8_t  kBare      = 20;      ///< First of the pins without anything attached
+const uint8_t  kScanPin   = 16;      ///< Right pin of scanner lane 0, lanes use pins 16-23
+const size_t   kTraceSize = 400000;  ///< Edges in the waveform buffer
+const uint8_t  kRuns      = 9;       ///< Timing runs, the fastest one is reported
+EncoderSimEdge trace[kTraceSize];    ///< Waveform buffer
+bool           failed = false;       ///< Set when a decoded count is wrong
+ROTARY_ENCODER_EEPROM_VECTOR         // The EncoderStore writes from the ready interrupt
+const EncoderKeyframe kFlashes[] PROGMEM = {
+    ROTARY_KEYFRAME(0, 255, 255, 0),     // 0: Red on
+    ROTARY_KEYFRAME(0, 255, 255, 10),    // 1: for 10ms,
+    ROTARY_KEYFRAME(255, 255, 255, 0),   // 2: off
+    ROTARY_KEYFRAME(255, 255, 255, 10),  // 3: for 10ms,
+    ROTARY_LOOP(0, 2),                   // 4: 3 flashes,
+    ROTARY_KEYFRAME(255, 255, 255, 20),  // 5: a pause,
+    ROTARY_KEYFRAME(0, 255, 255, 0),     // 6: red on
+    ROTARY_KEYFRAME(255, 255, 255, 10),  // 7: and fading out,
+    ROTARY_LOOP(6, 1),                   // 8: 2 more flashes
+    ROTARY_KEYFRAME(255, 0, 255, 0),     // 9: and end with green on
+    ROTARY_END};                         ///< Two counted loops and the end keyframe
+const EncoderKeyframe kForever[] PROGMEM = {
+    ROTARY_KEYFRAME(0, 255, 255, 0), ROTARY_KEYFRAME(0, 255, 255, 10),
+    ROTARY_KEYFRAME(255, 255, 255, 0), ROTARY_KEYFRAME(255, 255, 255, 10),
+    ROTARY_LOOP(0, 0)};  ///< Flashes until stopped
+
+struct Timing {
+  /*!
+   * @struct Timing
+   * @brief  Duration of one measured operation
+   */
+  double ns;      ///< Nanoseconds
+  double cycles;  ///< Time stamp counter cycles, 0 if not available
+};                // of structure Timing
+
+class Stopwatch {
+  /*!
+   * @class Stopwatch
+   * @brief Measures the host time and cycles of a block of code
+   */
+ public:
+  Stopwatch() : _Start(std::chrono::steady_clock::now()) {
+#if defined(BENCH_CYCLES)
+    _Cycles = BENCH_CYCLES;
+#endif
+  }  ///< Start measuring
+  /*!
+    @brief     Return the time since the start divided by a number of operations
+    @param[in] Count Number of operations measured
+    @return    Time per operation
+  */
+  Timing Per(const double Count) const {
+    Timing result;
+    result.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _Start)
+                    .count() /
+                Count;
+    result.cycles = 0;
+#if defined(BENCH_CYCLES)
+    result.cycles = (BENCH_CYCLES - _Cycles) / Count;
+#endif
+    return result;
+  }  // of method Per()
+ private:
+  std::chrono::steady_clock::time_point _Start;      ///< Host time at the start
+  unsigned long long                    _Cycles{0};  ///< Time stamp counter at the start
+};                                                   // of class Stopwatch
+
+static void Report(const char* Name, const Timing& Time) {
+  /*!
+    @brief     Print one timing line
+    @param[in] Name Description of the operation
+    @param[in] Time Time per operation
+  */
+  if (Time.cycles > 0)
+    printf("  %-40s %8.1f ns %8.1f cycles\n", Name, Time.ns, Time.cycles);
+  else
+    printf("  %-40s %8.1f ns\n", Name, Time.ns);
+}  // of function Report()
+static Timing Fastest(const Timing& A, const Timing& B) {
+  /*!
+    @brief     Return the faster of two timings
+    @param[in] A First timing
+    @param[in] B Second timing
+    @return    The timing with fewer nanoseconds
+  */
+  return A.ns <= B.ns ? A : B;
+}  // of function Fastest()
+static void Settle() {
+  /*!
+    @brief   Let the simulated time run on for a second
+    @details Long enough for fades to finish and for the button lockout to expire
+  */
+  EncoderSimulator::AdvanceMicros(1000000);
+}  // of function Settle()
+static void CheckCount(const char* Name, const int32_t Expected, const int32_t Decoded,
+                       const size_t Edges) {
+  /*!
+    @brief     Print and check one decoded count
+    @param[in] Name     Description of the case
+    @param[in] Expected Expected count
+    @param[in] Decoded  Count decoded by the library
+    @param[in] Edges    Number of edges in the waveform, including bounces, 0 for a plain value
+  */
+  int32_t expected = Expected < 0 ? -Expected : Expected;
+  int32_t error    = Decoded - Expected;
+  if (error < 0) error = -error;
+  double accuracy = expected ? 100.0 * (expected - (error > expected ? expected : error)) / expected
+                             : (error ? 0.0 : 100.0);
+  if (Edges)
+    printf("  %-40s %7zu edges %7ld expected %7ld decoded %7.2f%%\n", Name, Edges, (long)Expected,
+           (long)Decoded, accuracy);
+  else
+    printf("  %-40s %21ld expected %7ld found\n", Name, (long)Expected, (long)Decoded);
+  if (Decoded != Expected) failed = true;
+}  // of function CheckCount()
+static size_t Interleave(const size_t* Ends, const uint8_t Count, const uint32_t Offset) {
+  /*!
+    @brief     Merge several waveforms into one in which they all play at the same time
+    @details   The waveforms are stored one after the other at the start of the trace buffer, each
+               ending at its entry in "Ends". Waveform i is started "Offset" * i microseconds
+               later than the first, and the merged waveform is built behind them in the buffer
+               and then moved to its start.
+    @param[in] Ends   End of each waveform in the trace buffer
+    @param[in] Count  Number of waveforms
+    @param[in] Offset Microseconds between the starts of the waveforms
+    @return    Number of edges in the merged waveform
+  */
+  size_t   next[ROTARY_SCANNER_LANES], start = Ends[Count - 1], n = start;
+  uint32_t time[ROTARY_SCANNER_LANES], now = 0;
+  for (uint8_t i = 0; i < Count; i++) {
+    next[i] = i ? Ends[i - 1] : 0;
+    time[i] = Offset * i + (next[i] < Ends[i] ? trace[next[i]].delay : 0);
+  }  // of for-next each waveform
+  for (;;) {
+    uint8_t first = Count;
+    for (uint8_t i = 0; i < Count; i++)  // Find the waveform with the earliest next edge
+      if (next[i] < Ends[i] && (first == Count || time[i] < time[first])) first = i;
+    if (first == Count) break;
+    trace[n]       = trace[next[first]++];
+    trace[n].delay = time[first] - now;
+    now            = time[first];
+    if (next[first] < Ends[first]) time[first] += trace[next[first]].delay;
+    n++;
+  }  // of for-ever until all edges are merged
+  memmove(trace, trace + start, (n - start) * sizeof(EncoderSimEdge));
+  return n - start;
+}  // of function Interleave()
+static void RotateAccuracy(EncoderClass& Encoder, const bool Polling) {
+  /*!
+    @brief     Decode waveforms with increasing contact bounce
+    @details   Each waveform turns 1000 transitions one way and then 1000 the other way. The bounce
+               pulses are 20us apart, so even 8 of them are over long before the next edge, which
+               comes 2ms later.
+    @param[in] Encoder Encoder to test
+    @param[in] Polling true to sample the pins from the timer tick
+  */
+  static const uint8_t bounces[] = {0, 1, 2, 4, 8};
+  Encoder.SetPolling(Polling);
+  for (uint8_t b = 0; b < sizeof(bounces); b++) {
+    for (int8_t direction = 1; direction >= -1; direction -= 2) {
+      Encoder.SetEncoderValue(0);
+      size_t n = EncoderSimulator::GenerateQuadrature(trace, kTraceSize, kLeft, kRight,
+                                                      1000 * direction, 2000, bounces[b], 20);
+      EncoderSimulator::Replay(trace, n);
+      EncoderSimulator::AdvanceMicros(10000);  // Let the polling integrators settle
+      char name[48];
+      snprintf(name, sizeof(name), "%s %s, %u bounces", Polling ? "polled" : "interrupt",
+               direction > 0 ? "CW" : "CCW", bounces[b]);
+      CheckCount(name, 1000 * direction, Encoder.GetEncoderValue32(), n);
+    }  // of for-next each direction
+  }    // of for-next each bounce count
+  Encoder.SetPolling(false);
+}  // of function RotateAccuracy()
+static size_t AddPress(size_t Count, const uint8_t Button, const uint16_t WaitMillis,
+                       const uint16_t HoldMillis, const uint8_t Bounces) {
+  /*!
+    @brief     Add a button press to the waveform buffer
+    @details   The button is pressed after the wait time, held and then released. Both edges are
+               preceded by bounce pulses 50us apart.
+    @param[in] Count      Number of edges already in the buffer
+    @param[in] Button     Pushbutton pin
+    @param[in] WaitMillis Milliseconds before the press
+    @param[in] HoldMillis Milliseconds the button is held
+    @param[in] Bounces    Number of bounce pulses before each edge
+    @return    Number of edges in the buffer
+  */
+  for (uint8_t level = 1; level <= 2; level++) {  // Press, then release
+    uint8_t  value = level == 1 ? HIGH : LOW;
+    uint32_t delay = (level == 1 ? WaitMillis : HoldMillis) * 1000UL;
+    for (uint8_t i = 0; i < Bounces; i++) {       // Bounce before the edge
+      trace[Count++] = {delay, Button, value};
+      trace[Count++] = {50, Button, (uint8_t)!value};
+      delay          = 50;
+    }                                             // of for-next each bounce
+    trace[Count++] = {delay, Button, value};      // The real edge
+  }                                               // of for-next press and release
+  return Count;
+}  // of function AddPress()
+static void CheckEvents(const char* Name, EncoderClass& Encoder, const uint8_t* Expected,
+                        const uint8_t Count) {
+  /*!
+    @brief     Print and check the events in the event buffer of an encoder
+    @param[in] Name     Description of the case
+    @param[in] Encoder  Encoder whose events are read, the buffer is emptied
+    @param[in] Expected Expected event types, oldest first
+    @param[in] Count    Number of expected events
+  */
+  EncoderEvent event;
+  uint8_t      types[ROTARY_EVENT_BUFFER_SIZE], n = 0;
+  while (Encoder.PopEvent(event)) types[n++] = event.type;
+  bool ok = n == Count;
+  for (uint8_t i = 0; ok && i < n; i++) ok = types[i] == Expected[i];
+  printf("  %-40s", Name);
+  for (uint8_t i = 0; i < n; i++) printf(" %u", types[i]);
+  printf("%s\n", ok ? "" : " wrong");
+  if (!ok) failed = true;
+}  // of function CheckEvents()
+static void ButtonAccuracy(EncoderClass& Encoder, const uint8_t Button, const bool Polling) {
+  /*!
+    @brief     Press the button 20 times with increasing contact bounce
+    @details   Each press bounces on both edges, is held for 100ms and is followed by 300ms with the
+               button released, so every press is longer than the 150ms lockout
+    @param[in] Encoder Encoder to test
+    @param[in] Button  Pushbutton pin of the encoder
+    @param[in] Polling true to sample the pins from the timer tick
+  */
+  static const uint8_t bounces[] = {0, 4, 8};
+  Encoder.SetPolling(Polling);
+  for (uint8_t b = 0; b < sizeof(bounces); b++) {
+    Settle();
+    Encoder.GetButton();  // Clear the count
+    size_t n = 0;
+    for (uint8_t press = 0; press < 20; press++) n = AddPress(n, Button, 300, 100, bounces[b]);
+    EncoderSimulator::Replay(trace, n);
+    EncoderSimulator::AdvanceMicros(10000);
+    char name[48];
+    snprintf(name, sizeof(name), "%s button, %u bounces",
+             Polling                                              ? "polled"
+             : digitalPinToInterrupt(Button) == NOT_AN_INTERRUPT ? "sampled"
+                                                                  : "interrupt",
+             bounces[b]);
+    CheckCount(name, 20, Encoder.GetButton(), n);
+  }  // of for-next each bounce count
+  Encoder.SetPolling(false);
+}  // of function ButtonAccuracy()
+static Timing ReplayTiming(const size_t Count) {
+  /*!
+    @brief     Replay the waveform buffer several times
+    @param[in] Count Number of edges in the buffer
+    @return    Fastest time per edge
+  */
+  Timing best = {1e30, 0};
+  for (uint8_t run = 0; run < kRuns; run++) {
+    Settle();
+    Stopwatch watch;
+    EncoderSimulator::Replay(trace, Count);
+    best = Fastest(best, watch.Per(Count));
+  }  // of for-next each run
+  return best;
+}  // of function ReplayTiming()
+static void GestureAccuracy(EncoderClass& Encoder, const bool Polling) {
+  /*!
+    @brief     Check the events of the gesture recognizer
+    @details   Every press bounces 4 times on both edges. The default times are used, a long press
+               after 600ms and repeats every 200ms, so holding the button for 1300ms gives a long
+               press and 3 repeats. The events are printed as EncoderEventType numbers.
+    @param[in] Encoder Encoder to test
+    @param[in] Polling true to sample the pins from the timer tick
+  */
+  static const uint8_t click[]    = {ENCODER_PUSH, ENCODER_CLICK};
+  static const uint8_t twice[]    = {ENCODER_PUSH, ENCODER_PUSH, ENCODER_DOUBLE};
+  static const uint8_t held[]     = {ENCODER_PUSH, ENCODER_LONG, ENCODER_REPEAT, ENCODER_REPEAT,
+                                     ENCODER_REPEAT};
+  static const uint8_t heldOnce[] = {ENCODER_PUSH, ENCODER_LONG};
+  const char*          mode       = Polling ? "polled" : "interrupt";
+  char                 name[48];
+  EncoderEvent         event;
+  Encoder.SetPolling(Polling);
+  Encoder.SetGestures(true);
+  Settle();
+  while (Encoder.PopEvent(event)) {}  // Start with an empty event buffer
+  EncoderSimulator::Replay(trace, AddPress(0, kButton, 100, 100, 4));
+  Settle();
+  snprintf(name, sizeof(name), "%s click", mode);
+  CheckEvents(name, Encoder, click, sizeof(click));
+  size_t n = AddPress(0, kButton, 100, 100, 4);
+  EncoderSimulator::Replay(trace, AddPress(n, kButton, 100, 100, 4));
+  Settle();
+  snprintf(name, sizeof(name), "%s double click", mode);
+  CheckEvents(name, Encoder, twice, sizeof(twice));
+  EncoderSimulator::Replay(trace, AddPress(0, kButton, 100, 1300, 4));
+  Settle();
+  snprintf(name, sizeof(name), "%s long press, 3 repeats", mode);
+  CheckEvents(name, Encoder, held, sizeof(held));
+  Encoder.SetGestureTimes(600, 300, 0);  // No repeats
+  EncoderSimulator::Replay(trace, AddPress(0, kButton, 100, 1300, 4));
+  Settle();
+  snprintf(name, sizeof(name), "%s long press, no repeats", mode);
+  CheckEvents(name, Encoder, heldOnce, sizeof(heldOnce));
+  Encoder.SetGestureTimes(600, 0, 200);  // No double clicks, so clicks come on the release
+  EncoderSimulator::Replay(trace, AddPress(0, kButton, 100, 100, 4));
+  EncoderSimulator::AdvanceMicros(20000);  // Only the debounce time after the release
+  snprintf(name, sizeof(name), "%s click, no double clicks", mode);
+  CheckEvents(name, Encoder, click, sizeof(click));
+  Encoder.SetGestureTimes(600, 300, 200);
+  Encoder.SetGestures(false);
+  Encoder.SetPolling(false);
+}  // of function GestureAccuracy()
+static uint16_t CountFlashes(const uint8_t Pin, const uint16_t Millis) {
+  /*!
+    @brief     Count how often an LED is turned fully on while the simulated time runs on
+    @param[in] Pin    LED pin
+    @param[in] Millis Milliseconds to run for, sampled every timer tick
+    @return    Number of times the PWM value changed to 0, fully on
+  */
+  uint16_t flashes = 0;
+  uint8_t  last    = EncoderSimulator::GetPWM(Pin);
+  for (uint32_t tick = 0; tick < Millis * 2UL; tick++) {
+    EncoderSimulator::AdvanceMicros(500);
+    uint8_t now = EncoderSimulator::GetPWM(Pin);
+    if (now == 0 && last != 0) flashes++;
+    last = now;
+  }  // of for-next each tick
+  return flashes;
+}  // of function CountFlashes()
+static void AnimationAccuracy(EncoderClass& Encoder) {
+  /*!
+    @brief     Check the keyframe animations
+    @details   The red LED flashes are counted for an animation with two counted loops, for
+               one which loops forever, and for one started by a button press while the event
+               buffer is full. The end keyframe must leave the LEDs on the last color and let the
+               timer tick stop.
+    @param[in] Encoder Encoder to test, with the red LED on pin 9 and the green one on pin 10
+  */
+  Settle();
+  Encoder.PlayAnimation(kFlashes);
+  CheckCount("animation, counted loops", 5, CountFlashes(9, 1000), 0);
+  CheckCount("animation end, green on", 0, EncoderSimulator::GetPWM(10), 0);
+  Settle();
+#if !defined(ROTARY_HAL_COUNTER)  // A counted encoder keeps the timer running
+  CheckCount("animation end, timer stopped", 0, EncoderSimulator::TimerMask, 0);
+#endif
+  Encoder.PlayAnimation(kForever);
+  CheckCount("animation looping forever, 1s", 47, CountFlashes(9, 1000), 0);  // Every 21ms
+  Encoder.StopAnimation();
+  Settle();
+#if !defined(ROTARY_HAL_COUNTER)  // A counted encoder keeps the timer running
+  CheckCount("animation stopped, timer stopped", 0, EncoderSimulator::TimerMask, 0);
+#endif
+  EncoderEvent event;
+  while (Encoder.PopEvent(event)) {}  // Fill the event buffer with steps
+  uint16_t overflows = Encoder.GetEventOverflows();
+  size_t   n         = EncoderSimulator::GenerateQuadrature(trace, kTraceSize, kLeft, kRight,
+                                                            ROTARY_EVENT_BUFFER_SIZE, 2000);
+  EncoderSimulator::Replay(trace, n);
+  Settle();
+  Encoder.SetAnimation(ENCODER_PUSH, kFlashes);
+  EncoderSimulator::SetPin(kButton, HIGH);
+  CheckCount("animation on a full event buffer", 5, CountFlashes(9, 1000), 0);
+  EncoderSimulator::SetPin(kButton, LOW);
+  CheckCount("push event dropped", 1, Encoder.GetEventOverflows() - overflows, 0);
+  Encoder.SetAnimation(ENCODER_PUSH, nullptr);
+  while (Encoder.PopEvent(event)) {}
+  Settle();
+}  // of function AnimationAccuracy()
+static int32_t rotated = 0;  ///< Sum of the deltas passed to the OnRotate() handler
+static void     Rotated(EncoderClass& Encoder, const int32_t Delta) {
+  /*!
+    @brief     OnRotate() handler which adds up the deltas
+    @param[in] Encoder Encoder which was turned
+    @param[in] Delta   Net change of the value
+  */
+  (void)Encoder;
+  rotated += Delta;
+}  // of function Rotated()
+static void Turn(const int32_t Steps, const uint32_t Interval) {
+  /*!
+    @brief     Turn the encoder of the main instance
+    @param[in] Steps    Transitions, positive for clockwise
+    @param[in] Interval Microseconds between transitions
+  */
+  EncoderSimulator::Replay(trace, EncoderSimulator::GenerateQuadrature(trace, kTraceSize, kLeft,
+                                                                       kRight, Steps, Interval));
+}  // of function Turn()
+static void DetentAccuracy(EncoderClass& Encoder) {
+  /*!
+    @brief     Check the x1 and x2 resolutions of SetStepsPerDetent()
+    @details   400 transitions, 100 detents, are turned each way with 4 bounces on every edge.
+               When the library is built with ROTARY_SIM_COUNTER set to 1 the transitions are
+               counted by the simulated counter, as on an ESP32.
+    @param[in] Encoder Encoder to test
+  */
+#if defined(ROTARY_HAL_COUNTER)
+  bool counted = false;  // The first tick moves the encoder pins to a counter
+  for (uint8_t unit = 0; unit < SIM_COUNTERS; unit++)
+    if (EncoderSimulator::CounterPins[unit][0] == kLeft) counted = true;
+  counted = counted && EncoderSimulator::Handlers[kLeft] == nullptr;  // and detaches the pins
+  CheckCount("counter set up by the timer tick", 1, counted, 0);
+#endif
+  static const uint8_t perDetent[] = {4, 2};
+  for (uint8_t i = 0; i < sizeof(perDetent); i++) {
+    Encoder.SetStepsPerDetent(perDetent[i]);
+    for (int8_t direction = 1; direction >= -1; direction -= 2) {
+      Encoder.SetEncoderValue(0);
+      size_t n = EncoderSimulator::GenerateQuadrature(trace, kTraceSize, kLeft, kRight,
+                                                      400 * direction, 2000, 4, 20);
+      EncoderSimulator::Replay(trace, n);
+      EncoderSimulator::AdvanceMicros(10000);
+      char name[48];
+      snprintf(name, sizeof(name), "x%u %s, 4 bounces", 4 / perDetent[i],
+               direction > 0 ? "CW" : "CCW");
+      CheckCount(name, 400 / perDetent[i] * direction, Encoder.GetEncoderValue32(), n);
+    }  // of for-next each direction
+  }    // of for-next each resolution
+  Encoder.SetStepsPerDetent(1);
+}  // of function DetentAccuracy()
+static void CheckRange(EncoderClass& Encoder, const char* Name, const int32_t Min,
+                       const int32_t Max, const bool Wrap, const int32_t Start,
+                       const int8_t Direction, const uint8_t Steps) {
+  /*!
+    @brief     Turn the encoder within a range with a multiplier of 16 and check every step
+    @details   The encoder is first turned 40 transitions the same way at 1ms, so that the default
+               acceleration curve settles on a multiplier of 16, and then one transition at a time,
+               comparing the value with the expected one after each. The deltas passed to the
+               OnRotate() handler must add up to the net moves along the range.
+    @param[in] Encoder   Encoder to test
+    @param[in] Name      Description of the case
+    @param[in] Min       Lower limit of the range
+    @param[in] Max       Upper limit of the range
+    @param[in] Wrap      true to wrap around, false to stop at the limits
+    @param[in] Start     Value to start from
+    @param[in] Direction 1 to turn clockwise, -1 counterclockwise
+    @param[in] Steps     Number of transitions to check
+  */
+  Encoder.SetRange(INT32_MIN, INT32_MAX, false);
+  Turn(40 * Direction, 1000);
+  Encoder.SetRange(Min, Max, Wrap);
+  Encoder.SetEncoderValue(Start);
+  Encoder.Service();
+  rotated          = 0;
+  int64_t expected = Start, moved = 0, span = (int64_t)Max - Min + 1;
+  int32_t wrong    = 0;
+  for (uint8_t i = 0; i < Steps; i++) {
+    Turn(Direction, 1000);
+    int64_t next = expected + 16 * Direction;
+    if (Wrap)
+      next = Min + (((next - Min) % span) + span) % span;
+    else
+      next = next > Max ? Max : next < Min ? Min : next;
+    moved += Wrap ? (16 % span) * Direction : next - expected;
+    expected = next;
+    if (Encoder.GetEncoderValue32() != expected) wrong++;
+  }  // of for-next each transition
+  Encoder.Service();
+  CheckCount(Name, (int32_t)expected, Encoder.GetEncoderValue32(), 0);
+  if (wrong) CheckCount("  transitions with a wrong value", 0, wrong, 0);
+  CheckCount("  sum of the OnRotate() deltas", (int32_t)moved, rotated, 0);
+  EncoderSimulator::AdvanceMicros(300000);  // Let the velocity estimate decay
+}  // of function CheckRange()
+static void RangeAccuracy(EncoderClass& Encoder) {
+  /*!
+    @brief     Check SetRange() with steps of 16 at the limits of the range and of 32 bits
+    @param[in] Encoder Encoder to test
+  */
+  Encoder.SetAcceleration(true);
+  Encoder.OnRotate(Rotated);
+  CheckRange(Encoder, "stop at INT32_MAX", INT32_MIN, INT32_MAX, false, INT32_MAX - 40, 1, 5);
+  CheckRange(Encoder, "stop at INT32_MIN", INT32_MIN, INT32_MAX, false, INT32_MIN + 40, -1, 5);
+  CheckRange(Encoder, "stop at INT32_MAX, range", -10, INT32_MAX, false, INT32_MAX - 5, 1, 3);
+  CheckRange(Encoder, "wrap at INT32_MAX, range", -10, INT32_MAX, true, INT32_MAX - 5, 1, 3);
+  CheckRange(Encoder, "wrap at INT32_MIN, range", INT32_MIN, 5, true, INT32_MIN + 5, -1, 3);
+  CheckRange(Encoder, "wrap 0-99, step < span, CW", 0, 99, true, 90, 1, 20);
+  CheckRange(Encoder, "wrap 0-99, step < span, CCW", 0, 99, true, 5, -1, 20);
+  CheckRange(Encoder, "wrap 0-9, step > span, CW", 0, 9, true, 9, 1, 20);
+  CheckRange(Encoder, "wrap 0-9, step > span, CCW", 0, 9, true, 0, -1, 20);
+  CheckRange(Encoder, "wrap 0-15, step = span", 0, 15, true, 3, 1, 5);
+  Encoder.OnRotate(nullptr);
+  Encoder.SetAcceleration(false);
+  Encoder.SetRange(INT32_MIN, INT32_MAX, false);
+  Encoder.SetEncoderValue(0);
+}  // of function RangeAccuracy()
+static void Save(EncoderStore& Store) {
+  /*!
+    @brief     Call Service() every millisecond until the store has saved the encoder
+    @param[in] Store Store to service
+  */
+  for (uint16_t i = 0; i < 1000 && Store.Service(); i++) EncoderSimulator::AdvanceMicros(1000);
+}  // of function Save()
+static int32_t Restored(EncoderClass& Encoder) {
+  /*!
+    @brief     Restore the encoder from a new store, as after a power cycle
+    @param[in] Encoder Encoder to restore
+    @return    Restored value, -1 if no record was found
+  */
+  Encoder.SetEncoderValue(-1);
+  EncoderStore store(Encoder, 0, 2);
+  return store.Restore() ? Encoder.GetEncoderValue32() : -1;
+}  // of function Restored()
+static void StoreAccuracy(EncoderClass& Encoder) {
+  /*!
+    @brief     Check that a record cut off by a power failure is ignored
+    @details   A record is saved and the next one is cut off after 3 bytes by destroying its store,
+               as if the power had failed. The store must stop writing and release the EEPROM, a
+               new store must restore the complete record and then save and restore a new one.
+    @param[in] Encoder Encoder to save
+  */
+  EncoderSimulator::EepromErase();
+  Encoder.SetEncoderValue(0);
+  {
+    EncoderStore store(Encoder, 0, 2);
+    store.SetIdleTime(10);
+    store.Restore();
+    Encoder.SetEncoderValue(1234);
+    Save(store);
+    Encoder.SetEncoderValue(5678);
+    uint32_t start = EncoderSimulator::EepromWrites;
+    for (uint16_t i = 0; i < 10000 && EncoderSimulator::EepromWrites - start < 3; i++) {
+      store.Service();
+      EncoderSimulator::AdvanceMicros(100);
+    }  // of for-next until 3 bytes are written
+  }    // of scope of the store, the record is torn
+  uint32_t writes = EncoderSimulator::EepromWrites;
+  EncoderSimulator::AdvanceMicros(100000);
+  CheckCount("EEPROM writes after the power cut", 0, EncoderSimulator::EepromWrites - writes, 0);
+  CheckCount("EEPROM ready interrupt left on", 0, EncoderSimulator::EepromInterrupt, 0);
+  CheckCount("torn record ignored", 1234, Restored(Encoder), 0);
+  {
+    EncoderStore store(Encoder, 0, 2);
+    store.SetIdleTime(10);
+    store.Restore();
+    Encoder.SetEncoderValue(4321);
+    Save(store);
+  }  // of scope of the store
+  CheckCount("record saved after the power cut", 4321, Restored(Encoder), 0);
+  Encoder.SetEncoderValue(0);
+}  // of function StoreAccuracy()
+static void ScannerAccuracy() {
+  /*!
+    @brief   Decode 4 encoders on one port with the scanner
+    @details All 4 lanes are turned at the same time by different amounts, each with its own
+             start offset so that the edges of different lanes don't coincide, and the scanner
+             runs from the timer tick
+  */
+  static const int16_t steps[ROTARY_SCANNER_LANES] = {300, -200, 100, -400};
+  static const uint8_t bounces[]                    = {0, 4};
+  EncoderScanner       scanner(kScanPin);
+  for (uint8_t lane = 0; lane < ROTARY_SCANNER_LANES; lane++)
+    if (scanner.AddEncoder(kScanPin + 2 * lane + 1, kScanPin + 2 * lane) != (int8_t)lane)
+      failed = true;
+  if (!scanner.Begin(true)) failed = true;
+  for (uint8_t b = 0; b < sizeof(bounces); b++) {
+    size_t ends[ROTARY_SCANNER_LANES], n = 0;
+    for (uint8_t lane = 0; lane < ROTARY_SCANNER_LANES; lane++) {
+      scanner.SetPosition(lane, 0);
+      n += EncoderSimulator::GenerateQuadrature(trace + n, kTraceSize / 2 - n,
+                                                kScanPin + 2 * lane + 1, kScanPin + 2 * lane,
+                                                steps[lane], 2000, bounces[b], 20);
+      ends[lane] = n;
+    }  // of for-next each lane
+    scanner.GetChanged();  // Clear the changed lanes
+    n = Interleave(ends, ROTARY_SCANNER_LANES, 500);
+    EncoderSimulator::Replay(trace, n);
+    EncoderSimulator::AdvanceMicros(10000);
+    if (scanner.GetChanged() != 0b1111) failed = true;
+    for (uint8_t lane = 0; lane < ROTARY_SCANNER_LANES; lane++) {
+      char name[48];
+      snprintf(name, sizeof(name), "scanner lane %u, %u bounces", lane, bounces[b]);
+      CheckCount(name, steps[lane], scanner.GetPosition(lane), n);
+    }  // of for-next each lane
+  }    // of for-next each bounce count
+}  // of function ScannerAccuracy()
+static void RotateTiming() {
+  /*!
+    @brief   Measure the rotate interrupt
+    @details 40000 clean transitions are replayed on the pins of the EncoderClass instance, on the
+             pins of a RotaryEncoder template instance and on two pins without interrupts. The
+             difference to the last is the time spent in the rotate interrupt, the last figure is
+             the time of the simulation itself. The transitions have no time between them, so that
+             no timer ticks are simulated in between and the timing isn't drowned by the time of
+             the simulation. On the host the template only saves the registry lookup, the compile
+             time PINx reads are only used on the ATmega328P and ATmega168.
+  */
+  RotaryEncoder<kLeftT, kRightT, kSampled> Template;
+  size_t n    = EncoderSimulator::GenerateQuadrature(trace, kTraceSize, kLeft, kRight, 40000, 0);
+  Timing all  = ReplayTiming(n);
+  for (size_t i = 0; i < n; i++) trace[i].pin += kLeftT - kLeft;  // Template instance pins
+  Timing tmpl = ReplayTiming(n);
+  for (size_t i = 0; i < n; i++) trace[i].pin += kBare - kLeftT;  // Unattached pins
+  Timing bare = ReplayTiming(n);
+  Report("replay with interrupts, per edge", all);
+  Report("replay without interrupts, per edge", bare);
+  Report("rotate interrupt, per edge", {all.ns - bare.ns, all.cycles - bare.cycles});
+  Report("template rotate interrupt, per edge", {tmpl.ns - bare.ns, tmpl.cycles - bare.cycles});
+}  // of function RotateTiming()
+namespace Decoders {
+/*!
+  @brief   The old and the new quadrature decoder, without the rest of the rotate interrupt
+  @details Both keep the same state and set the same target colors as the library does, so that
+           the only difference between them is how the pins are read and how the transition is
+           decoded
+*/
+const uint8_t kOldLeft = 12, kOldRight = 13;  ///< Pins decoded by the old decoder
+const uint8_t kNewLeft = 14, kNewRight = 15;  ///< Pins decoded by the new decoder
+static constexpr int8_t kTable[16] = {0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0};
+EncoderPort*            leftPort;          ///< Input register of the new left pin
+EncoderPort*            rightPort;         ///< Input register of the new right pin
+uint8_t                 leftMask;          ///< Bit of the new left pin
+uint8_t                 rightMask;         ///< Bit of the new right pin
+volatile int32_t        value{0};          ///< Decoded value
+volatile bool           changed{false};    ///< Set on every decoded step
+volatile uint8_t        red, green, blue;  ///< Target color
+uint8_t                 lastEncoded{0};    ///< Previous pin state
+static void Old() {
+  /*!
+    @brief   The rotate interrupt of library version 1.0.6
+    @details digitalRead() of both pins and an if-chain over the 8 valid transitions
+  */
+  uint8_t encoded = ((uint8_t)digitalRead(kOldLeft) << 1) | (uint8_t)digitalRead(kOldRight);
+  uint8_t sum     = (lastEncoded << 2) | encoded;
+  if (sum == 0b1101 || sum == 0b0100 || sum == 0b0010 || sum == 0b1011) {
+    value++;
+    changed = true;
+    red = 1, green = 2, blue = 3;
+  } else if (sum == 0b1110 || sum == 0b0111 || sum == 0b0001 || sum == 0b1000) {
+    value--;
+    changed = true;
+    red = 4, green = 5, blue = 6;
+  }  // of if-then-else a valid transition
+  lastEncoded = encoded;
+}  // of function Old()
+static void New() {
+  /*!
+    @brief   The rotate interrupt since library version 1.0.7
+    @details Direct reads of the input registers and a lookup in the transition table
+  */
+  uint8_t encoded   = ((*leftPort & leftMask) ? 0b10 : 0) | ((*rightPort & rightMask) ? 0b01 : 0);
+  int8_t  direction = kTable[(lastEncoded << 2) | encoded];
+  lastEncoded       = encoded;
+  if (direction == 0) return;
+  value += direction;
+  changed = true;
+  if (direction > 0)
+    red = 1, green = 2, blue = 3;
+  else
+    red = 4, green = 5, blue = 6;
+}  // of function New()
+}  // namespace Decoders
+static void DecoderTiming() {
+  /*!
+    @brief   Compare the old and the new decoder
+    @details The same 40000 transitions are replayed on the pins of each decoder and on two pins
+             without interrupts, whose time is subtracted from the others
+  */
+  using namespace Decoders;
+  leftPort  = portInputRegister(digitalPinToPort(kNewLeft));
+  rightPort = portInputRegister(digitalPinToPort(kNewRight));
+  leftMask  = digitalPinToBitMask(kNewLeft);
+  rightMask = digitalPinToBitMask(kNewRight);
+  attachInterrupt(digitalPinToInterrupt(kOldLeft), Old, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(kOldRight), Old, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(kNewLeft), New, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(kNewRight), New, CHANGE);
+  size_t n = EncoderSimulator::GenerateQuadrature(trace, kTraceSize, kOldLeft, kOldRight, 40000, 0);
+  value      = 0;
+  Timing old = ReplayTiming(n);
+  CheckCount("old decoder, all runs", kRuns * 40000, value, n);
+  for (size_t i = 0; i < n; i++) trace[i].pin += kNewLeft - kOldLeft;
+  value      = 0;
+  Timing now = ReplayTiming(n);
+  CheckCount("new decoder, all runs", kRuns * 40000, value, n);
+  for (size_t i = 0; i < n; i++) trace[i].pin += kBare - kNewLeft;  // Unattached pins
+  Timing bare    = ReplayTiming(n);
+  Timing oldTime = {old.ns - bare.ns, old.cycles - bare.cycles};
+  Timing newTime = {now.ns - bare.ns, now.cycles - bare.cycles};
+  Report("old digitalRead decoder, per edge", oldTime);
+  Report("new table decoder, per edge", newTime);
+  Report("saved per edge", {oldTime.ns - newTime.ns, oldTime.cycles - newTime.cycles});
+}  // of function DecoderTiming()
+static void TickTiming(EncoderClass& Encoder) {
+  /*!
+    @brief     Measure the timer tick
+    @details   The tick is called directly, once with nothing to do and once while the longest
+               possible fade is running
+    @param[in] Encoder Encoder to test
+  */
+  const uint32_t ticks = 1000000;
+  Timing         idle = {1e30, 0}, fading = {1e30, 0};
+  for (uint8_t run = 0; run < kRuns; run++) {
+    Settle();
+    Stopwatch watch;
+    for (uint32_t i = 0; i < ticks; i++) EncoderClass::TimerISR();
+    idle = Fastest(idle, watch.Per(ticks));
+  }  // of for-next each run
+  Encoder.SetFadeTime(32767);  // The longest fade, 65534 ticks
+  for (uint8_t run = 0; run < kRuns; run++) {
+    Settle();
+    Encoder.SetColor(0, 0, 0);  // Full on, then fade back to off
+    Stopwatch watch;
+    for (uint32_t i = 0; i < 60000; i++) EncoderClass::TimerISR();  // All within the fade
+    fading = Fastest(fading, watch.Per(60000));
+  }  // of for-next each run
+  Encoder.SetFadeTime(0);
+  Report("timer tick, idle", idle);
+  Report("timer tick, fading", fading);
+}  // of function TickTiming()
+int main(int argc, char* argv[]) {
+  /*!
+    @brief     Run all benchmarks
+    @param[in] argc Number of arguments
+    @param[in] argv Arguments, "--check" to return 1 when a count is wrong
+    @return    0, or 1 with "--check" when a count was wrong
+  */
+  bool check = argc > 1 && strcmp(argv[1], "--check") == 0;
+  EncoderSimulator::AdvanceMicros(200000);  // Start after the button lockout of millis() 0
+  EncoderClass Encoder(kLeft, kRight, kButton, 9, 10, 11);
+  printf("Decoding accuracy\n");
+  RotateAccuracy(Encoder, false);
+  RotateAccuracy(Encoder, true);
+  ButtonAccuracy(Encoder, kButton, false);
+  ButtonAccuracy(Encoder, kButton, true);
+  {  // The sampled pushbutton keeps the timer running, so the instance is removed again
+    RotaryEncoder<kLeftT, kRightT, kSampled> Template;
+    ButtonAccuracy(Template, kSampled, false);
+  }  // of scope of the template instance
+  GestureAccuracy(Encoder, false);
+  GestureAccuracy(Encoder, true);
+  AnimationAccuracy(Encoder);
+  DetentAccuracy(Encoder);
+  RangeAccuracy(Encoder);
+  StoreAccuracy(Encoder);
+  ScannerAccuracy();
+  printf("Timing, fastest of %u runs\n", kRuns);
+  RotateTiming();
+  TickTiming(Encoder);
+  DecoderTiming();
+  printf("%s\n", failed ? "FAILED" : "OK");
+  return check && failed ? 1 : 0;
+}  // of function main()
@@ -4,222 +4,1207 @@
     Arduino Library for reading a rotary encoder \n\n
     See the main library header file for all details
 */
-#include "RotaryEncoder.h"             // Include the header file
-EncoderClass* EncoderClass::ClassPtr;  ///< Declare Class Reference pointer
+#include "RotaryEncoder.h"  // Include the header file
+#if defined(__AVR__)
+  #include <avr/sleep.h>  // Sleep modes for Sleep()
+#endif
+#if ROTARY_ENCODER_STATS
+  #define ROTARY_STAT(Statement) Statement  ///< Statistics code, only compiled when enabled
+#else
+  #define ROTARY_STAT(Statement)  ///< Statistics code, only compiled when enabled
+#endif
+/*!
+  @brief   States of the button gesture recognizer
+*/
+enum : uint8_t {
+  GESTURE_IDLE  = 0,  ///< Button released, nothing pending
+  GESTURE_DOWN  = 1,  ///< Button pressed, waiting for a release or the long press time
+  GESTURE_WAIT  = 2,  ///< Button released after a click, waiting for a second click
+  GESTURE_DOWN2 = 3,  ///< Button pressed for the second time
+  GESTURE_HELD  = 4   ///< Long press reported, repeating while held
+};
+static constexpr uint8_t kGestureDebounce = 10;  ///< Milliseconds a button level must be stable
+EncoderClass* EncoderClass::_Instances[ROTARY_MAX_ENCODERS];  ///< Registry of active instances
+bool          EncoderClass::_PinChangeWake{false};             ///< Set by the PCINT vector macro
+volatile bool EncoderClass::_PoweredDown{false};               ///< Set during power-down sleep
+volatile bool EncoderClass::_CountersPending{false};           ///< Set until the tick sets them up
+/*!
+  @brief   LED writers for the public constructor
+  @details Indexed with bit 0 set if there is a red LED, bit 1 for green and bit 2 for blue
+*/
+const EncoderClass::LEDWriter EncoderClass::_LEDWriters[8] = {
+    WriteLEDs<false, false, false>, WriteLEDs<true, false, false>, WriteLEDs<false, true, false>,
+    WriteLEDs<true, true, false>,   WriteLEDs<false, false, true>, WriteLEDs<true, false, true>,
+    WriteLEDs<false, true, true>,   WriteLEDs<true, true, true>};
+/*!
+  @brief   Quadrature transition table
+  @details Indexed by the previous 2-bit pin state shifted left by 2 and ORd with the current 2-bit
+           pin state. A value of +1 is a clockwise step, -1 a counterclockwise step and 0 is either
+           no movement or an invalid transition where both pins changed at the same time.
+*/
+static constexpr int8_t kQuadratureTable[16] ROTARY_DRAM = {
+    0,  -1, 1,  0,   // 0b00xx - from both pins low
+    1,  0,  0,  -1,  // 0b01xx - from right pin high
+    -1, 0,  0,  1,   // 0b10xx - from left pin high
+    0,  1,  -1, 0};  // 0b11xx - from both pins high
+/*!
+  @brief   Gamma correction table
+  @details The LEDs are driven to ground, so a PWM value of 255 is off and 0 is full brightness. The
+           eye doesn't see brightness linearly, so when gamma correction is turned on the faded PWM
+           value is looked up in this table which applies a gamma of 2.2 to the brightness, making
+           a linear fade look linear. The table is stored in program memory.
+*/
+static const uint8_t kGammaTable[256] PROGMEM ROTARY_DRAM = {
+    0,   2,   4,   7,   9,   11,  13,  15,  17,  19,  21,  24,  26,  28,  30,  32,  34,  36,  38,
+    40,  42,  44,  46,  48,  50,  52,  54,  56,  58,  59,  61,  63,  65,  67,  69,  71,  73,  74,
+    76,  78,  80,  82,  83,  85,  87,  89,  90,  92,  94,  96,  97,  99,  101, 102, 104, 106, 107,
+    109, 110, 112, 114, 115, 117, 118, 120, 122, 123, 125, 126, 128, 129, 131, 132, 134, 135, 136,
+    138, 139, 141, 142, 144, 145, 146, 148, 149, 150, 152, 153, 155, 156, 157, 158, 160, 161, 162,
+    164, 165, 166, 167, 168, 170, 171, 172, 173, 174, 176, 177, 178, 179, 180, 181, 182, 184, 185,
+    186, 187, 188, 189, 190, 191, 192, 193, 194, 195, 196, 197, 198, 199, 200, 201, 202, 203, 204,
+    205, 206, 206, 207, 208, 209, 210, 211, 212, 212, 213, 214, 215, 216, 216, 217, 218, 219, 220,
+    220, 221, 222, 222, 223, 224, 225, 225, 226, 227, 227, 228, 229, 229, 230, 230, 231, 232, 232,
+    233, 233, 234, 235, 235, 236, 236, 237, 237, 238, 238, 239, 239, 240, 240, 241, 241, 242, 242,
+    242, 243, 243, 244, 244, 244, 245, 245, 246, 246, 246, 247, 247, 247, 248, 248, 248, 249, 249,
+    249, 249, 250, 250, 250, 250, 251, 251, 251, 251, 252, 252, 252, 252, 252, 253, 253, 253, 253,
+    253, 253, 253, 254, 254, 254, 254, 254, 254, 254, 254, 254, 254, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255};
+template <>
+void EncoderClass::AttachISRs<ROTARY_MAX_ENCODERS>(const uint8_t slot) {
+  /*!
+    @brief     End of the AttachISRs() recursion
+    @details   Reached when the registry was full, in which case no interrupts are attached and the
+               instance remains inactive
+    @param[in] slot Registry slot of the instance (unused)
+  */
+  (void)slot;
+}  // of method AttachISRs()
+template <uint8_t Slot>
+void EncoderClass::AttachISRs(const uint8_t slot) {
+  /*!
+    @brief     Attach the interrupt trampolines for a registry slot
+    @details   The Arduino attachInterrupt() function only accepts a plain function pointer, so each
+               registry slot has its own instantiation of the static RotateISR() and PushButtonISR()
+               functions. This template recurses at compile time until it reaches the requested
+               slot and then attaches that slot's trampolines to the instance's pins.
+    @param[in] slot Registry slot of the instance
+  */
+  if (slot != Slot) {            // If this isn't the slot, then
+    AttachISRs<Slot + 1>(slot);  // try the next one
+    return;
+  }  // of if-then not the requested slot
+  EncoderClass* instance = _Instances[Slot];
+  instance->_RotateISR   = RotateISR<Slot>;      // Remember the trampolines, so that they
+  instance->_PushISR     = PushButtonISR<Slot>;  // can be detached and attached again
+  instance->AttachPins();
+}  // of method AttachISRs()
+void EncoderClass::AttachPins() {
+  /*!
+    @brief   Attach the pin interrupts to the instance's trampolines
+    @details The pushbutton interrupt is only attached to both edges while the gesture recognizer
+             needs to see the releases, otherwise only presses cause an interrupt
+    @return  void
+  */
+  if (_Counter == ROTARY_NO_COUNTER) {  // Counted encoders need no rotate interrupts
+    attachInterrupt(digitalPinToInterrupt(_LeftPin), _RotateISR, CHANGE);   // Attach static
+    attachInterrupt(digitalPinToInterrupt(_RightPin), _RotateISR, CHANGE);  // internal
+  }                                                                        // functions
+  if (!_PollButton)  // A pushbutton without an interrupt is sampled on the timer tick
+    attachInterrupt(digitalPinToInterrupt(_PushbuttonPin), _PushISR, _Gestures ? CHANGE : RISING);
+}  // of method AttachPins()
+void EncoderClass::DetachPins() {
+  /*!
+    @brief   Detach the pin interrupts of the instance
+    @return  void
+  */
+  if (_Counter == ROTARY_NO_COUNTER) {
+    detachInterrupt(digitalPinToInterrupt(_LeftPin));
+    detachInterrupt(digitalPinToInterrupt(_RightPin));
+  }  // of if-then rotate interrupts attached
+  if (!_PollButton) detachInterrupt(digitalPinToInterrupt(_PushbuttonPin));
+}  // of method DetachPins()
 EncoderClass::EncoderClass(const uint8_t LeftPin, const uint8_t RightPin,  // Class constructor
                            const uint8_t PushbuttonPin, const uint8_t RedPin,
                            const uint8_t GreenPin, const uint8_t BluePin, const bool HWDebounce)
+    : EncoderClass(LeftPin, RightPin, PushbuttonPin, RedPin, GreenPin, BluePin, HWDebounce, true,
+                   _LEDWriters[(RedPin != 255) | (GreenPin != 255) << 1 | (BluePin != 255) << 2]) {
+  /*!
+    @brief   Class constructor
+    @details Sets up the encoder and attaches the interrupts of the registry slot, see the
+             protected constructor below. The LED writer is picked from the pins which exist, so
+             that the LED writes of the fader don't test the pins.
+  */
+}  // of class constructor
+EncoderClass::EncoderClass(const uint8_t LeftPin, const uint8_t RightPin,
+                           const uint8_t PushbuttonPin, const uint8_t RedPin,
+                           const uint8_t GreenPin, const uint8_t BluePin, const bool HWDebounce,
+                           const bool Attach, const LEDWriter Writer)
     : _LeftPin(LeftPin),
       _RightPin(RightPin),
       _PushbuttonPin(PushbuttonPin),
       _RedPin(RedPin),
       _GreenPin(GreenPin),
-      _BluePin(BluePin) {
+      _BluePin(BluePin),
+      _WriteLEDs(Writer) {
   /*!
     @brief   Class constructor
     @details The class constructor stores the pin values as part of the initializer and then uses
              an indirect method to attach the interrupts to the appropriate routines. The Arduino
-             design method doesn't allow interrupts to be attached to class members. The interrupt
-             ISR is attached to the local static function, which in turn uses a pointer to the
-             class with an offset to the appropriate function to call the correct function.
+             design method doesn't allow interrupts to be attached to class members. The instance
+             is stored in the first free slot of the registry and the interrupts are attached to
+             that slot's static trampoline functions, which in turn use the registry pointer to
+             call the handlers of the correct instance. If all ROTARY_MAX_ENCODERS slots are
+             already in use then no interrupts are attached. The RotaryEncoder template passes
+             false for "Attach" and attaches its own trampolines instead. The encoder pins are
+             decoded in the pin interrupts until the first timer tick, which moves them to a free
+             quadrature counter of the hardware abstraction if there is one, see StartCounters().
+             A pushbutton pin without an external interrupt is sampled and debounced on the timer
+             tick instead, see PollHandler().
   */
   pinMode(RedPin, OUTPUT);
   pinMode(GreenPin, OUTPUT);
-  pinMode(BluePin, OUTPUT);                         // Set LED color pins to output
-  if (RedPin != 255) analogWrite(RedPin, 255);      // If the LED pins are defined,
-  if (GreenPin != 255) analogWrite(GreenPin, 255);  // then turn them off at the start
-  if (BluePin != 255) analogWrite(BluePin, 255);
+  pinMode(BluePin, OUTPUT);                 // Set LED color pins to output
+  bool wide;                                // Look up the PWM compare registers once,
+  _RedOCR = EncoderHAL::PWMRegister(RedPin, wide);  // so that the fader can write the new
+  if (wide) _WideOCR |= 0b001;                      // values to them directly
+  _GreenOCR = EncoderHAL::PWMRegister(GreenPin, wide);
+  if (wide) _WideOCR |= 0b010;
+  _BlueOCR = EncoderHAL::PWMRegister(BluePin, wide);
+  if (wide) _WideOCR |= 0b100;
+  WritePWM(255, 255, 255);                  // Turn the LEDs off at the start
   pinMode(LeftPin, INPUT);         // Define encoder pins as input
   pinMode(RightPin, INPUT);        // Define encoder pins as input
   pinMode(PushbuttonPin, INPUT);   // Define pushbutton pin as input
+  _LeftPort  = portInputRegister(digitalPinToPort(LeftPin));   // Look up the PINx registers and
+  _RightPort = portInputRegister(digitalPinToPort(RightPin));  // the bit masks once so that the
+  _LeftMask  = digitalPinToBitMask(LeftPin);                   // rotate ISR can read the pins
+  _RightMask = digitalPinToBitMask(RightPin);                  // directly
+  _ButtonPort = portInputRegister(digitalPinToPort(PushbuttonPin));
+  _ButtonMask = digitalPinToBitMask(PushbuttonPin);
   if (!HWDebounce) {               // If SW debounce then enable pullup
     digitalWrite(LeftPin, HIGH);   // Turn the pull-up resistor on
     digitalWrite(RightPin, HIGH);  // Turn the pull-up resistor on
   }                                // of if-then hardware or software debounce
   _EncoderValue = 0;               // Reset in case it was changed
-  ClassPtr      = this;            // pointer to current instance
-  attachInterrupt(digitalPinToInterrupt(LeftPin), RotateISR,
-                  CHANGE);  // Attach static internal function
-  attachInterrupt(digitalPinToInterrupt(RightPin), RotateISR,
-                  CHANGE);  // Attach static internal function
-  attachInterrupt(digitalPinToInterrupt(PushbuttonPin), PushButtonISR,
-                  RISING);  // Attach static internal function
+  for (uint8_t i = 0; i < ROTARY_MAX_ENCODERS; i++) {  // Find the first free registry slot
+    if (_Instances[i] == nullptr) {                    // and register this instance there
+      _Slot         = i;
+      _Instances[i] = this;
+      break;
+    }  // of if-then slot is free
+  }    // of for-next each registry slot
+  if (_Slot != ROTARY_MAX_ENCODERS) {
+#if defined(ROTARY_HAL_COUNTER)
+    _CounterPullups = !HWDebounce;       // The timer tick counts the encoder pins in hardware
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // if it can, as the constructor may run too early to
+      _CounterPending  = true;           // set up the counter
+      _CountersPending = true;
+      ArmTimer();
+    }  // of atomic block
+#endif
+    if (digitalPinToInterrupt(PushbuttonPin) == NOT_AN_INTERRUPT) {  // Sample the pushbutton
+      bool level = *_ButtonPort & _ButtonMask;                       // on the timer tick,
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {                            // starting from its
+        _PollCount[2] = level ? _PollSamples : 0;                    // current level
+        _PollState    = level ? 0b100 : 0;
+        _PollButton   = true;
+        ArmTimer();
+      }  // of atomic block
+    }    // of if-then pushbutton pin without an interrupt
+  }      // of if-then registered
+  if (Attach) AttachISRs<0>(_Slot);  // Attach the slot's trampolines
   if (RedPin == 255 && GreenPin == 255 && BluePin == 255)
     SetFadeRate(0);  // If no LEDs, turn off fader
   else
     SetFadeRate(1);  // turn on fader to max speed
 }  // of class constructor
-ISR(TIMER0_COMPA_vect) {
+EncoderClass::~EncoderClass() {
   /*!
-    @brief   Interrupt vector for TIMER0_COMPA
-    @details Indirect call to the TimerISR()
+    @brief   Class destructor
+    @details Detaches the pin interrupts and removes the instance from the registry so that the
+             slot can be reused by another instance
   */
-  EncoderClass::TimerISR();
-}  // Call the ISR every millisecond
-ISR(TIMER0_COMPB_vect) {
-  /*!
-    @brief   Interrupt vector for TIMER0_COMPB
-    @details Indirect call to the TimerISR()
-  */
-  EncoderClass::TimerISR();
-}  // Call the ISR every millisecond
-static void EncoderClass::PushButtonISR() {
+  if (_Slot == ROTARY_MAX_ENCODERS) return;  // Nothing to do if never registered
+  DetachPins();
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { _Instances[_Slot] = nullptr; }  // Free the registry slot
+  if (_Counter != ROTARY_NO_COUNTER) EncoderHAL::CounterEnd(_Counter);
+}  // of class destructor
+template <uint8_t Slot>
+void ROTARY_IRAM EncoderClass::PushButtonISR() {
   /*!
     @brief   Interrupt vector for the pushbutton ISR
-    @details Indirect call to the PushButtonHandler() routine
+    @details Indirect call to the PushButtonHandler() routine of the instance in the slot
   */
-  ClassPtr->PushButtonHandler();
+  _Instances[Slot]->PushButtonHandler();
 }  // Redirect to real handler function
-static void EncoderClass::RotateISR() {
+template <uint8_t Slot>
+void ROTARY_IRAM EncoderClass::RotateISR() {
   /*!
     @brief   Interrupt vector for the rotate ISR
-    @details Indirect call to the RotateHandler() routine
+    @details Indirect call to the RotateHandler() routine of the instance in the slot
   */
-  ClassPtr->RotateHandler();
+  _Instances[Slot]->RotateHandler();
 }  // Redirect to real handler function
-static void EncoderClass::TimerISR() {
+void ROTARY_IRAM EncoderClass::TimerISR() {
   /*!
     @brief   Interrupt vector for the timer ISR
-    @details Indirect call to the TimerHandler() routine
+    @details Calls the TimerHandler() routine of every registered instance in turn, so one timer
+             tick services the fades of all encoders. When no instance has anything left to do the
+             timer tick is turned off, so that an idle encoder uses no CPU time. It is turned on
+             again by ArmTimer() when the next color is set. Only the handlers run with
+             ROTARY_ISR_GUARD, the hardware counters are set up and, on the ESP32, the LEDs are
+             written outside of it.
   */
-  ClassPtr->TimerHandler();
+#if defined(ROTARY_HAL_COUNTER)
+  if (_CountersPending) StartCounters();  // Set up the counters of new instances
+#endif
+  {
+    ROTARY_ISR_GUARD;
+#if defined(ROTARY_HAL_BYTE_PORTS)
+    bool busy = EncoderScanner::ScanAll(true);  // Scanners in timer mode need every tick
+#else
+    bool busy = false;
+#endif
+    for (uint8_t i = 0; i < ROTARY_MAX_ENCODERS; i++) {
+      EncoderClass* instance = _Instances[i];
+      if (instance == nullptr) continue;
+      ROTARY_STAT(uint32_t start = StatsClock());
+      if (instance->_Polling || instance->_PollButton) {  // Polled instances sample their
+        instance->PollHandler();                          // pins on every tick and so keep
+        busy = true;                                      // the timer running
+      }                                                   // of if-then polled instance
+      if (instance->_Counter != ROTARY_NO_COUNTER) {  // Hardware counters are read
+        instance->CounterHandler();                   // on every tick and so also
+        busy = true;                                  // keep the timer running
+      }                                               // of if-then counted instance
+      if (instance->_Gestures && instance->GestureHandler()) busy = true;
+      if (instance->TimerHandler()) busy = true;
+      ROTARY_STAT(instance->StatsTime(start));
+    }                                     // of for-next each registry slot
+    if (!busy) EncoderHAL::TimerStop();  // Turn the timer off when all are idle
+  }                                      // of guarded handlers
+#if defined(ROTARY_HAL_ESP32)
+  FlushLEDs();  // analogWrite() can't be called in the critical section
+#endif
 }  // Redirect to real handler function
-void EncoderClass::TimerHandler() {
+void EncoderClass::StartCounters() {
+  /*!
+    @brief   Move the encoders waiting for a hardware counter to one
+    @details Called by the timer tick outside of ROTARY_ISR_GUARD, as the counter drivers can't be
+             used in a critical section. The constructors only mark the encoders, as they may run
+             before the drivers can be used. Each encoder gets a free counter unit, then its rotate
+             interrupts are detached and the transitions counted so far are dropped, since the pin
+             interrupts had already decoded them. When no unit is free the encoder keeps using the
+             pin interrupts.
+    @return  void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { _CountersPending = false; }
+  for (uint8_t i = 0; i < ROTARY_MAX_ENCODERS; i++) {
+    EncoderClass* instance = _Instances[i];
+    if (instance == nullptr || !instance->_CounterPending) continue;
+    instance->_CounterPending = false;
+    uint8_t unit = EncoderHAL::CounterBegin(instance->_LeftPin, instance->_RightPin,
+                                            instance->_CounterPullups);
+    if (unit == ROTARY_NO_COUNTER) continue;  // Keep decoding in the pin interrupts
+    detachInterrupt(digitalPinToInterrupt(instance->_LeftPin));
+    detachInterrupt(digitalPinToInterrupt(instance->_RightPin));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      EncoderHAL::CounterSteps(unit);  // Already decoded in the pin interrupts
+      instance->_Counter = unit;
+    }  // of atomic block
+  }    // of for-next each registry slot
+}  // of method StartCounters()
+void ROTARY_IRAM EncoderClass::ArmTimer() {
+  /*!
+    @brief   Turn on the timer tick used for fading
+    @details The tick calls TimerISR() every 1/2 millisecond, see EncoderHAL::TimerStart(). Must
+             be called with interrupts disabled, as is always the case in the interrupt handlers.
+    @return  void
+  */
+  EncoderHAL::TimerStart();
+}  // of method ArmTimer()
+void ROTARY_IRAM EncoderClass::PollHandler() {
+  /*!
+    @brief   Sample and debounce the encoder pins in polling mode
+    @details Called on every timer tick while polling is turned on, and otherwise for the
+             pushbutton alone when its pin has no external interrupt. Each sampled pin has an
+             integrator which counts up on every high sample and down on every low sample, between
+             0 and the number of samples set with SetPolling(). The debounced level of a pin only
+             changes when its integrator reaches either end, so a bounce burst shorter than that
+             number of ticks is filtered out completely. A change of the debounced encoder pins is
+             decoded with the transition table and a change of the pushbutton is passed to the
+             pushbutton edge handler.
+    @return  void
+  */
+  uint8_t raw   = ((*_LeftPort & _LeftMask) ? 0b010 : 0) |     // Sample the left,
+                ((*_RightPort & _RightMask) ? 0b001 : 0) |   // right and
+                ((*_ButtonPort & _ButtonMask) ? 0b100 : 0);  // pushbutton pins
+  uint8_t state = _PollState;
+  for (uint8_t i = _Polling ? 0 : 2; i < 3; i++) {  // Only the pushbutton unless polling
+    uint8_t bit = 1 << i;
+    if (raw & bit) {  // Count up on a high sample, down on a low one and change at either end
+      if (_PollCount[i] < _PollSamples && ++_PollCount[i] == _PollSamples) state |= bit;
+    } else {
+      if (_PollCount[i] > 0 && --_PollCount[i] == 0) state &= ~bit;
+    }  // of if-then-else high or low sample
+  }    // of for-next each pin
+  uint8_t changed = state ^ _PollState;
+  _PollState      = state;
+  if ((changed & 0b011) && _Counter == ROTARY_NO_COUNTER) RotateStep(state & 0b011);  // Decode
+  if (changed & 0b100) ButtonEdge(state & 0b100);    // Debounced button edge
+}  // of method PollHandler()
+void EncoderClass::SetPolling(const bool Status, const uint8_t Samples) {
+  /*!
+    @brief     Turn polling mode on or off
+    @details   In polling mode the pin interrupts are detached and the pins are instead sampled on
+               every timer tick, 2000 times a second, and debounced in software, see PollHandler().
+               This puts a fixed limit on the interrupt load however much the encoder bounces, at
+               the cost of a maximum step rate of about 1000 transitions a second divided by the
+               number of samples. The debounced state starts from the current pin levels.
+    @param[in] Status  true to poll the pins, false to use the pin interrupts
+    @param[in] Samples Number of consecutive equal samples needed to change a pin, 1-255
+    @return    void
+  */
+  if (_Slot == ROTARY_MAX_ENCODERS) return;  // Nothing to do if never registered
+  uint8_t samples = Samples ? Samples : 1;
+  uint8_t state   = ((*_LeftPort & _LeftMask) ? 0b010 : 0) |     // Start from the
+                  ((*_RightPort & _RightMask) ? 0b001 : 0) |   // current levels
+                  ((*_ButtonPort & _ButtonMask) ? 0b100 : 0);  // of the pins
+  if (Status && !_Polling) DetachPins();  // No more pin interrupts when polling
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    for (uint8_t i = 0; i < 3; i++) _PollCount[i] = (state & (1 << i)) ? samples : 0;
+    _PollSamples = samples;
+    _PollState   = state;
+    _LastEncoded = state & 0b011;
+    _Polling     = Status;
+    if (Status) ArmTimer();  // The timer handler does the sampling
+  }                          // of atomic block
+  if (!Status && _RotateISR != nullptr) AttachPins();  // Back to the pin interrupts
+}  // of method SetPolling()
+bool ROTARY_IRAM EncoderClass::TimerHandler() {
   /*!
     @brief   Handler to the timer event
-    @details This is linked to the millis() timer 0 interrupt. The TimerISR() limits how often this
-             is called and each time it is triggered it performs any adjustments between the actual
-             and target values of the RGB LEDs of the device. It is also the only place where the
-             actual PWM values for RGB are set.
+    @details This is linked to the millis() timer 0 interrupt and is called every 1/2 millisecond.
+             The LED levels are 8.8 fixed point values and a fade is done by adding a per-channel
+             step to them on every tick, counting the ticks down until the fade is complete. At the
+             end of a fade the levels are set exactly to their targets and if any LED isn't off a
+             second fade back to off is started, so each rotate or pushbutton event shows its
+             color and then fades away. No division is done here, the steps are calculated with a
+             multiplication by the reciprocal of the fade length when a fade starts.
+    @return  true while a fade is in progress, false when the instance no longer needs the timer
+  */
+  if (_Program != nullptr) return AnimationStep();  // A playing animation owns the LEDs
+  if (_FadeTicks == 0) return false;      // Nothing to do if fading is off
+  if (_LEDChanged) {                      // If an event set new targets,
+    _LEDChanged = false;                  // then reset the flag and
+    StartFade();                          // start fading towards them
+  }                                       // of if-then new targets set
+  if (_FadeTicksLeft == 0) return false;  // Nothing to do if no fade is in progress
+  ROTARY_STAT(_Stats.fadeTicks++);
+  _RedActual += _RedStep;           // Move each LED one step
+  _GreenActual += _GreenStep;       // closer to its target
+  _BlueActual += _BlueStep;
+  if (--_FadeTicksLeft == 0) {                      // If the fade is complete, then
+    _RedActual   = (uint16_t)_RedTarget << 8;       // set the levels exactly
+    _GreenActual = (uint16_t)_GreenTarget << 8;     // to the targets to remove
+    _BlueActual  = (uint16_t)_BlueTarget << 8;      // any rounding errors
+    if (_RedTarget != 255 || _GreenTarget != 255 || _BlueTarget != 255) {  // If not off, then
+      _RedTarget   = 255;                           // fade all of the LEDs
+      _GreenTarget = 255;                           // back to off
+      _BlueTarget  = 255;
+      StartFade();
+    } else if (_OnFade != nullptr) {                // otherwise the LEDs are off again, so
+      _PendingFade = true;                          // tell the fade-complete handler
+    }  // of if-then-else LEDs aren't off
+  }    // of if-then fade complete
+  ShowColor(_RedActual >> 8, _GreenActual >> 8, _BlueActual >> 8);  // Show the new levels
+  return _FadeTicksLeft != 0;  // Busy until the fade back to off is complete
+}  // of method TimerHandler()
+void ROTARY_IRAM EncoderClass::StartFade() {
+  /*!
+    @brief   Start a fade from the current LED levels to the targets
+    @details Computes the 8.8 fixed point step for each channel so that the target is reached in
+             _FadeTicks ticks. The distance of each channel is multiplied by the 24-bit reciprocal
+             of the fade length, which was computed when the fade time was set, and shifted down by
+             16 bits. This needs no division, so it is cheap enough to run in the timer interrupt.
+    @return  void
+  */
+  _RedStep       = FadeStep(_RedActual, _RedTarget, _FadeRecip);
+  _GreenStep     = FadeStep(_GreenActual, _GreenTarget, _FadeRecip);
+  _BlueStep      = FadeStep(_BlueActual, _BlueTarget, _FadeRecip);
+  _FadeTicksLeft = _FadeTicks;
+}  // of method StartFade()
+void ROTARY_IRAM EncoderClass::EventColor(const uint8_t R, const uint8_t G, const uint8_t B) {
+  /*!
+    @brief     Show the color of a rotate or pushbutton event
+    @details   The color is set as the new target, shown right away if fading is turned off and
+               otherwise faded to by the timer. Nothing is done while an animation is playing.
+    @param[in] R Red value
+    @param[in] G Green value
+    @param[in] B Blue value
+    @return    void
+  */
+  if (_Program != nullptr) return;  // The animation owns the LEDs
+  _LEDChanged  = true;              // We are changing target values
+  _RedTarget   = R;                 // Set target color
+  _GreenTarget = G;                 // Set target color
+  _BlueTarget  = B;                 // Set target color
+  if (_FadeTicks == 0)              // Manually set if no fade
+    ShowColor(R, G, B);
+  else                              // otherwise make sure that
+    ArmTimer();                     // the fader is running
+}  // of method EventColor()
+void ROTARY_IRAM EncoderClass::StartAnimation(const EncoderKeyframe* Program) {
+  /*!
+    @brief     Start playing an animation from its first keyframe
+    @details   Called from the interrupt handlers when an event has an animation and from
+               PlayAnimation() with interrupts disabled. The first keyframe is loaded on the next
+               timer tick.
+    @param[in] Program Keyframes in program memory
+    @return    void
+  */
+  _Program       = Program;
+  _Frame         = 0;
+  _LoopsLeft     = 0;
+  _FadeTicksLeft = 0;      // Load the first keyframe on the next tick
+  _LEDChanged    = false;  // and forget any pending event color
+  ArmTimer();
+}  // of method StartAnimation()
+bool ROTARY_IRAM EncoderClass::AnimationStep() {
+  /*!
+    @brief   Advance the playing animation by one timer tick
+    @details When the current keyframe is complete the next one is read from program memory and
+             its fade is started with the same 8.8 fixed point engine as the event fades, using the
+             reciprocal of the keyframe length which the ROTARY_KEYFRAME macro computes at compile
+             time, so no division is done here. Loop keyframes jump back to an earlier keyframe,
+             either forever or for a number of repeats, and the end keyframe stops the animation.
+             The repeats are counted down in _LoopsLeft, which is 0 again whenever a counted loop
+             has finished, so counted loops can't be nested.
+             At most 4 loop keyframes are followed on one tick, so a program which loops without
+             any colors can't stall the interrupt.
+    @return  true while the animation is playing, false once it has ended
+  */
+  for (uint8_t jumps = 0; _FadeTicksLeft == 0 && jumps < 4;) {  // Load the next keyframe
+    const EncoderKeyframe* frame = _Program + _Frame;
+    uint16_t               ticks = pgm_read_word(&frame->ticks);
+    if (ticks == ROTARY_KEYFRAME_END) {  // End of the program, the
+      _Program = nullptr;                // LEDs keep the last color
+      return false;
+    }  // of if-then end keyframe
+    if (ticks == ROTARY_KEYFRAME_LOOP) {  // Loop keyframe
+      jumps++;
+      uint8_t repeats = pgm_read_byte(&frame->green);
+      if (repeats != 0) {                    // A counted loop ends after its repeats
+        if (_LoopsLeft == 0) {               // so count them down, starting
+          _LoopsLeft = repeats;              // on the first pass
+        } else if (--_LoopsLeft == 0) {      // and falling through to the next
+          _Frame++;                          // keyframe after the last one
+          continue;
+        }  // of if-then-else first or last pass
+      }    // of if-then counted loop
+      _Frame = pgm_read_byte(&frame->red);  // Jump back
+      continue;
+    }  // of if-then loop keyframe
+    _Frame++;
+    _RedTarget   = pgm_read_byte(&frame->red);
+    _GreenTarget = pgm_read_byte(&frame->green);
+    _BlueTarget  = pgm_read_byte(&frame->blue);
+    if (ticks == 0) {                              // Jump straight to the color
+      _RedActual   = (uint16_t)_RedTarget << 8;
+      _GreenActual = (uint16_t)_GreenTarget << 8;
+      _BlueActual  = (uint16_t)_BlueTarget << 8;
+      break;                                       // and show it for one tick
+    }                                              // of if-then no fade
+    uint32_t recip = pgm_read_dword(&frame->recip);
+    _RedStep       = FadeStep(_RedActual, _RedTarget, recip);
+    _GreenStep     = FadeStep(_GreenActual, _GreenTarget, recip);
+    _BlueStep      = FadeStep(_BlueActual, _BlueTarget, recip);
+    _FadeTicksLeft = ticks;
+  }  // of for-next until a keyframe is loaded
+  if (_FadeTicksLeft != 0) {
+    _RedActual += _RedStep;  // Move each LED one step
+    _GreenActual += _GreenStep;  // closer to its target
+    _BlueActual += _BlueStep;
+    if (--_FadeTicksLeft == 0) {                   // If the keyframe is complete, then
+      _RedActual   = (uint16_t)_RedTarget << 8;    // set the levels exactly
+      _GreenActual = (uint16_t)_GreenTarget << 8;  // to the targets
+      _BlueActual  = (uint16_t)_BlueTarget << 8;
+    }  // of if-then keyframe complete
+  }    // of if-then fading
+  ShowColor(_RedActual >> 8, _GreenActual >> 8, _BlueActual >> 8);  // Show the new levels
+  return true;
+}  // of method AnimationStep()
+void EncoderClass::SetAnimation(const uint8_t Type, const EncoderKeyframe* Program) {
+  /*!
+    @brief     Set the animation started by an event
+    @details   Whenever an event of this type is recorded the animation is started from its first
+               keyframe, replacing any animation which is playing. While an animation plays the
+               event colors aren't shown.
+    @param[in] Type    One of the EncoderEventType values
+    @param[in] Program Keyframes in program memory, nullptr to go back to the event color
+    @return    void
+  */
+  if (Type < ENCODER_CW || Type > ENCODER_REPEAT) return;  // Not an event type
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { _Animations[Type - 1] = Program; }
+}  // of method SetAnimation()
+void EncoderClass::PlayAnimation(const EncoderKeyframe* Program) {
+  /*!
+    @brief     Start playing an animation right away
+    @param[in] Program Keyframes in program memory
+    @return    void
+  */
+  if (Program == nullptr) return;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { StartAnimation(Program); }
+}  // of method PlayAnimation()
+void EncoderClass::StopAnimation() {
+  /*!
+    @brief   Stop the playing animation
+    @details The LEDs keep their current color, which the next event then replaces
+    @return  void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _Program       = nullptr;
+    _FadeTicksLeft = 0;
+  }  // of atomic block
+}  // of method StopAnimation()
+int16_t ROTARY_IRAM EncoderClass::FadeStep(const uint16_t Actual, const uint8_t Target,
+                                           const uint32_t Recip) {
+  /*!
+    @brief     Compute the 8.8 fixed point step to fade one channel
+    @param[in] Actual Current 8.8 fixed point level
+    @param[in] Target Target level
+    @param[in] Recip  24-bit reciprocal of the fade length in ticks
+    @return    Signed 8.8 fixed point step per tick
+  */
+  uint8_t current = Actual >> 8;                                   // Integer part of the level
+  if (Target >= current)                                           // Distance times reciprocal,
+    return (int16_t)(((uint32_t)(Target - current) * Recip) >> 16);  // for an increase
+  return -(int16_t)(((uint32_t)(current - Target) * Recip) >> 16);   // or a decrease
+}  // of method FadeStep()
+void ROTARY_IRAM EncoderClass::ShowColor(const uint8_t R, const uint8_t G, const uint8_t B) {
+  /*!
+    @brief     Write the RGB values to the LED pins
+    @details   Applies the gamma correction table when it is turned on. Nothing is written when the
+               LEDs have been turned off with SetLEDState().
+    @param[in] R Red value
+    @param[in] G Green value
+    @param[in] B Blue value
+    @return    void
+  */
+  if (!_LEDOn) return;  // Leave the LEDs off
+  if (_Gamma)           // Look up the corrected values
+    WritePWM(pgm_read_byte(&kGammaTable[R]), pgm_read_byte(&kGammaTable[G]),
+             pgm_read_byte(&kGammaTable[B]));
+  else
+    WritePWM(R, G, B);  // show the Red, Green, and Blue values
+}  // of method ShowColor()
+void ROTARY_IRAM EncoderClass::WritePWM(const uint8_t R, const uint8_t G, const uint8_t B) {
+  /*!
+    @brief     Write the PWM values of all three LEDs
+    @details   This is the only place where the LED pins are written. The LED writer chosen by the
+               constructor only writes the channels which have a pin, so no pin is tested here,
+               and channels whose value hasn't changed are skipped, which during a slow fade is
+               most of them. On the ESP32 analogWrite() can't be called from an interrupt or a
+               critical section, so the values are queued and written by the next timer tick, see
+               FlushLEDs().
+    @param[in] R Red PWM value
+    @param[in] G Green PWM value
+    @param[in] B Blue PWM value
+    @return    void
+  */
+#if defined(ROTARY_HAL_ESP32)
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _LEDQueue[0] = R;
+    _LEDQueue[1] = G;
+    _LEDQueue[2] = B;
+    _LEDsQueued  = true;
+    ArmTimer();  // The tick writes them
+  }              // of atomic block
+#else
+  _WriteLEDs(*this, R, G, B);
+#endif
+}  // of method WritePWM()
+#if defined(ROTARY_HAL_ESP32)
+void EncoderClass::FlushLEDs() {
+  /*!
+    @brief   Write the LED values queued by WritePWM()
+    @details Called by the timer tick in the esp_timer task, outside of the critical section. The
+             values are copied in the critical section and written after leaving it. A value
+             queued after the copy is written by the next tick, which ArmTimer() keeps running.
     @return  void
   */
-  if (_LEDChanged ||  // Only check if LEDs aren't off
-      !(_RedActual == 255 && _GreenActual == 255 && _BlueActual == 255)) {
-    if (millis() % _FadeMillis == 0) {  // If we are fading colors, then
-      _LEDChanged = false;              // Reset the value
-      if (_RedActual != _RedTarget) {   // adjust accordingly
-        if (_RedActual < _RedTarget)
-          _RedActual++;
-        else
-          _RedActual--;
-      }  // of if-then actual and target don't match
-      if (_GreenActual != _GreenTarget) {
-        if (_GreenActual < _GreenTarget)
-          _GreenActual++;
-        else
-          _GreenActual--;
-      }  // of if-then actual and target don't match
-      if (_BlueActual != _BlueTarget) {
-        if (_BlueTarget < _BlueTarget)
-          _BlueActual++;
-        else
-          _BlueActual--;
-      }  // of if-then actual and target don't match
-      if (_RedTarget != 255 && _RedActual == _RedTarget)
-        _RedTarget++;  // Fade Red if max has been reached
-      if (_GreenTarget != 255 && _GreenActual == _GreenTarget)
-        _GreenTarget++;  // Fade Green          "   "
-      if (_BlueTarget != 255 && _BlueActual == _BlueTarget)
-        _BlueTarget++;                       // Fade Blue           "   "
-      analogWrite(_RedPin, _RedActual);      // show the Red,
-      analogWrite(_GreenPin, _GreenActual);  // Green, and
-      analogWrite(_BluePin, _BlueActual);    // Blue values
-    }                                        // of if-then we want to fade LED brightness
-  }                                          // of if-then we need to do something
-}  // of method FaderButtonHandler()
-void EncoderClass::PushButtonHandler() {
-  /*!
-    @brief   Handler for button pushes
-    @details This is called when the interrupt occurs on a rising signal. Debouncing is done in the
-             hardware but we'll also add some checking here. The _ButtonPushed flag is cleared when
-             the ButtonPushed() function is called.
+  for (uint8_t i = 0; i < ROTARY_MAX_ENCODERS; i++) {
+    EncoderClass* instance = _Instances[i];
+    if (instance == nullptr || !instance->_LEDsQueued) continue;
+    uint8_t led[3];
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      led[0]                = instance->_LEDQueue[0];
+      led[1]                = instance->_LEDQueue[1];
+      led[2]                = instance->_LEDQueue[2];
+      instance->_LEDsQueued = false;
+    }  // of atomic block
+    instance->_WriteLEDs(*instance, led[0], led[1], led[2]);
+  }  // of for-next each registry slot
+}  // of method FlushLEDs()
+#endif
+void ROTARY_IRAM EncoderClass::WriteChannel(const uint8_t Pin, volatile uint8_t* Register,
+                                            const bool Wide, uint8_t& Shown, const uint8_t Value) {
+  /*!
+    @brief     Write the PWM value of one LED if it has changed
+    @details   analogWrite() looks up the timer of the pin on every call, and for the values 0 and
+               255 it disconnects the PWM output and sets the pin with digitalWrite(). So
+               analogWrite() is used whenever the old or the new value is 0 or 255 or the pin has no
+               known compare register, and in all other cases the PWM output is already connected
+               and only the compare register needs to be written.
+    @param[in]     Pin      Arduino pin number
+    @param[in]     Register PWM compare register of the pin, nullptr if unknown
+    @param[in]     Wide     true if the compare register is 16 bits wide
+    @param[in,out] Shown    Value which was last written to the pin
+    @param[in]     Value    New PWM value
+    @return        void
+  */
+  if (Value == Shown) return;  // Nothing to do if unchanged
+  if (Register != nullptr && Shown != 0 && Shown != 255 && Value != 0 && Value != 255) {
+    if (Wide)
+      *(volatile uint16_t*)Register = Value;  // Word write sets the high byte too
+    else
+      *Register = Value;
+  } else {
+    analogWrite(Pin, Value);  // Connect or disconnect the PWM output
+  }                           // of if-then-else register write possible
+  Shown = Value;
+}  // of method WriteChannel()
+void ROTARY_IRAM EncoderClass::PushButtonHandler() {
+  /*!
+    @brief   Handler for pushbutton interrupts
+    @details This is called when the interrupt occurs on a rising edge of the pushbutton signal or,
+             while gestures are turned on, on either edge. The pin is read to tell a press (high)
+             from a release (low).
     @return  void
   */
-  static long lastPushed = 0;                // Store the last button time
-  if (millis() - lastPushed > 150) {         // if time > 250ms then allow set
-    _ButtonPresses++;                        // Increment the counter
-    _LEDChanged  = true;                     // We are changing target values
-    changed      = true;                     // Something has changed
-    lastPushed   = millis();                 // Store new push button time
-    _RedTarget   = _ColorPushButtonR;        // Set target color
-    _GreenTarget = _ColorPushButtonG;        // Set target color
-    _BlueTarget  = _ColorPushButtonB;        // Set target color
-    if (_FadeMillis == 0) {                  // Manually set if no fade
-      analogWrite(_RedPin, _RedTarget);      // show the Red,
-      analogWrite(_GreenPin, _GreenTarget);  // Green, and
-      analogWrite(_BluePin, _BlueTarget);    // Blue values
-    }                                        // of if fading is turned off
-  }                                          // of if-then we have a valid pushbutton event
+  ROTARY_ISR_GUARD;
+  ButtonEdge(*_ButtonPort & _ButtonMask);
 }  // of method PushButtonHandler()
-void EncoderClass::RotateHandler() {
+void ROTARY_IRAM EncoderClass::ButtonEdge(const bool Pressed) {
+  /*!
+    @brief     Handle a pushbutton edge
+    @details   A press is counted when at least 150ms have passed since the last counted press.
+               Debouncing is done in the hardware but we'll also add some checking here. The
+               count is cleared when the GetButton() function is called. When gestures are turned
+               on, every edge also starts the timer so that the gesture recognizer can follow the
+               button, see GestureHandler(). The releases are then seen as well, and a press within
+               kGestureDebounce milliseconds of a release is the release bouncing, which after a
+               long press would otherwise be counted as a new press.
+    @param[in] Pressed true if the button is now pressed
+    @return    void
+  */
+  ROTARY_STAT(uint32_t start = StatsClock());
+  if (_Gestures) ArmTimer();                   // The timer tick follows the gesture
+  if (!Pressed) _LastReleased = millis();      // Bounces of a release are ignored
+  if (Pressed) {                               // Only presses are counted
+    if (millis() - _LastPushed > 150 &&        // if time > 150ms and not a release
+        millis() - _LastReleased >= kGestureDebounce) {  // bounce, then allow set
+      _ButtonPresses++;                        // Increment the counter
+      changed     = true;                      // Something has changed
+      _LastPushed = millis();                  // Store new push button time
+      PushEvent(ENCODER_PUSH);                 // Record the event
+      if (_OnPush != nullptr) _PendingPushes++;  // and count it for the push handler
+      EventColor(_ColorPushButtonR, _ColorPushButtonG, _ColorPushButtonB);  // Show the color
+    } else {                                   // otherwise it is a bounce
+      ROTARY_STAT(_Stats.bounces++);
+    }  // of if-then we have a valid pushbutton event
+  }    // of if-then button pressed
+  ROTARY_STAT(StatsTime(start));
+}  // of method ButtonEdge()
+bool ROTARY_IRAM EncoderClass::GestureHandler() {
+  /*!
+    @brief   Recognize button gestures
+    @details Called on every timer tick while gestures are turned on. The button is sampled on the
+             tick and its level only counts once it has been stable for kGestureDebounce
+             milliseconds, so contact bounce never reaches the state machine. The button edges
+             only start the timer. The recognized gestures are added to the event buffer:
+
+             - ENCODER_CLICK  when the button is released, or after the double click time if
+                              double clicks are turned on and no second press followed
+             - ENCODER_DOUBLE when the button is released after a second press within the double
+                              click time
+             - ENCODER_LONG   when the button has been held for the long press time
+             - ENCODER_REPEAT every repeat time while the button is still held after a long press
+
+             Times are kept as 16-bit millisecond values, so no gesture time can be longer than
+             65 seconds.
+    @return  true while the timer is needed, false when the button is idle
+  */
+  uint16_t now   = (uint16_t)millis();
+  bool     level = (_Polling || _PollButton) ? (_PollState & 0b100)  // Debounced or
+                                             : (*_ButtonPort & _ButtonMask);  // sampled level
+  if (level != _GestureRaw) {                       // If the level changed, then
+    _GestureRaw  = level;                           // restart the debounce time
+    _GestureEdge = now;
+  } else if (level != _GesturePressed &&                       // If the level is new and has
+             (uint16_t)(now - _GestureEdge) >= kGestureDebounce) {  // been stable, then
+    _GesturePressed = level;                        // take it over and
+    switch (_Gesture) {                             // advance the state machine
+      case GESTURE_IDLE:
+        if (level) {
+          _Gesture     = GESTURE_DOWN;
+          _GestureTime = now;
+        }  // of if-then pressed
+        break;
+      case GESTURE_DOWN:
+        if (!level) {
+          if (_DoubleMillis) {  // Wait to see if a second click follows
+            _Gesture     = GESTURE_WAIT;
+            _GestureTime = now;
+          } else {
+            GestureEvent(ENCODER_CLICK);
+          }  // of if-then-else double clicks turned on
+        }    // of if-then released
+        break;
+      case GESTURE_WAIT:
+        if (level) {
+          _Gesture     = GESTURE_DOWN2;
+          _GestureTime = now;
+        }  // of if-then pressed
+        break;
+      case GESTURE_DOWN2:
+        if (!level) GestureEvent(ENCODER_DOUBLE);
+        break;
+      default:  // GESTURE_HELD
+        if (!level) _Gesture = GESTURE_IDLE;
+        break;
+    }  // of switch gesture state
+  }    // of if-then-else new stable level
+  uint16_t elapsed = now - _GestureTime;  // Time in the current state
+  switch (_Gesture) {
+    case GESTURE_DOWN:
+    case GESTURE_DOWN2:
+      if (_LongMillis && elapsed >= _LongMillis) {  // Held long enough for a long press
+        GestureEvent(ENCODER_LONG);
+        _Gesture     = GESTURE_HELD;
+        _GestureTime = now;
+      }  // of if-then long press
+      break;
+    case GESTURE_HELD:
+      if (_RepeatMillis && elapsed >= _RepeatMillis) {  // Repeat while held
+        PushEvent(ENCODER_REPEAT);
+        changed = true;
+        _GestureTime += _RepeatMillis;
+      }  // of if-then repeat
+      break;
+    case GESTURE_WAIT:
+      if (elapsed >= _DoubleMillis) GestureEvent(ENCODER_CLICK);  // No second click
+      break;
+  }  // of switch gesture state
+  return _Gesture != GESTURE_IDLE || _GestureRaw != _GesturePressed;
+}  // of method GestureHandler()
+void ROTARY_IRAM EncoderClass::GestureEvent(const uint8_t Type) {
+  /*!
+    @brief     Report a gesture and return the recognizer to idle
+    @param[in] Type One of the ENCODER_CLICK, ENCODER_DOUBLE or ENCODER_LONG event types
+    @return    void
+  */
+  PushEvent(Type);
+  changed  = true;
+  _Gesture = Type == ENCODER_LONG ? GESTURE_HELD : GESTURE_IDLE;
+}  // of method GestureEvent()
+void EncoderClass::SetGestures(const bool Status) {
+  /*!
+    @brief     Turn the button gesture recognizer on or off
+    @details   The recognized gestures are added to the event buffer, see GestureHandler(). The
+               pushbutton counter read with GetButton() and the ENCODER_PUSH events aren't affected.
+               The pushbutton interrupt is attached again, to both edges while gestures are on and
+               to the rising edge only while they are off.
+    @param[in] Status true to recognize gestures
+    @return    void
+  */
+  bool level = (_Polling || _PollButton) ? (_PollState & 0b100) : (*_ButtonPort & _ButtonMask);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _Gesture        = GESTURE_IDLE;  // Start from the current
+    _GestureRaw     = level;         // button level
+    _GesturePressed = level;
+    _Gestures       = Status;
+  }                                      // of atomic block
+  if (!_Polling && !_PollButton && _PushISR != nullptr)  // Releases only needed by gestures
+    attachInterrupt(digitalPinToInterrupt(_PushbuttonPin), _PushISR, Status ? CHANGE : RISING);
+}  // of method SetGestures()
+void EncoderClass::SetGestureTimes(const uint16_t LongMillis, const uint16_t DoubleMillis,
+                                   const uint16_t RepeatMillis) {
+  /*!
+    @brief     Set the times used by the button gesture recognizer
+    @param[in] LongMillis   Milliseconds the button must be held for a long press, 0 for none
+    @param[in] DoubleMillis Maximum milliseconds between the release after the first click and the
+                            second press of a double click, 0 turns double clicks off so that
+                            clicks are reported right away
+    @param[in] RepeatMillis Milliseconds between repeats while held after a long press, 0 for none
+    @return    void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _LongMillis   = LongMillis;
+    _DoubleMillis = DoubleMillis;
+    _RepeatMillis = RepeatMillis;
+  }  // of atomic block
+}  // of method SetGestureTimes()
+void ROTARY_IRAM EncoderClass::RotateHandler() {
   /*!
     @brief   Handler for rotation interrupts
     @details The actual ISR called when a pin change on the left or right pin is detected. The
-             quadrature values for the 2 pins are read and the two bits are stored in the "encoded"
-             variable. This is ORd with the previous value to get 4 bits and there are only 8
-             possible values that denote a valid reading and inform us as to which direction the
-             dial was turned.
+             quadrature values for the 2 pins are read directly from the PINx registers and the
+             two bits are stored in the "encoded" variable. This is ORd with the previous value to
+             get 4 bits which are used as an index into the quadrature transition table, which
+             returns the direction the dial was turned or 0 if the transition isn't valid.
     @return  void
   */
-  static uint8_t lastEncoded = 0;                            // Save last encoded raw value
-  uint8_t encoded = ((uint8_t)digitalRead(_LeftPin) << 1) |  // converting the 2 pin values into
-                    (uint8_t)digitalRead(_RightPin);         // a  single number
-  uint8_t sum = (lastEncoded << 2) | encoded;                // add to previously encoded value
-  if (sum == 0b1101 || sum == 0b0100 || sum == 0b0010 ||
-      sum == 0b1011) {         // if clockwise turn direction
-    _EncoderValue++;           // add value and brighten the
-    changed      = true;       // Something has changed
-    _LEDChanged  = true;       // We are changing target values
-    _RedTarget   = _ColorCWR;  // Set target color
-    _GreenTarget = _ColorCWG;  // Set target color
-    _BlueTarget  = _ColorCWB;  // Set target color
-  } else if (sum == 0b1110 || sum == 0b0111 || sum == 0b0001 ||
-             sum == 0b1000) {              // if a counterclockwise turn
-    _EncoderValue--;                       // subtract the value and brighten
-    changed      = true;                   // Something has changed
-    _LEDChanged  = true;                   // We are changing target values
-    _RedTarget   = _ColorCCWR;             // Set target color
-    _GreenTarget = _ColorCCWG;             // Set target color
-    _BlueTarget  = _ColorCCWB;             // Set target color
-  }                                        // of if-then a CCW turn
-  lastEncoded = encoded;                   // store the value for next time
-  if (_FadeMillis == 0) {                  // Manually set if no fade
-    analogWrite(_RedPin, _RedTarget);      // show the Red,
-    analogWrite(_GreenPin, _GreenTarget);  // Green, and
-    analogWrite(_BluePin, _BlueTarget);    // Blue values
-  }                                        // of if fading is turned off
+  ROTARY_ISR_GUARD;
+  RotateStep(((*_LeftPort & _LeftMask) ? 0b10 : 0) |   // converting the 2 pin values
+             ((*_RightPort & _RightMask) ? 0b01 : 0));  // into a single number
 }  // of method RotateHandler()
+void ROTARY_IRAM EncoderClass::RotateStep(const uint8_t encoded) {
+  /*!
+    @brief     Decode a new quadrature pin state and update the encoder
+    @details   Called by RotateHandler() and by the RotaryEncoder template, which reads the pins
+               with compile-time port addresses. With more than one transition per detent, see
+               SetStepsPerDetent(), the transitions are added up and a step is only counted when
+               the pins reach a detent state again, so a turn which stops halfway and goes back
+               counts nothing. Each counted step is passed on to MoveValue().
+    @param[in] encoded Left pin state in bit 1 and right pin state in bit 0
+    @return    void
+  */
+  ROTARY_STAT(uint32_t start = StatsClock());
+  uint8_t sum       = (_LastEncoded << 2) | encoded;  // add to previously encoded value
+  int8_t  direction = kQuadratureTable[sum];          // look up the transition
+  _LastEncoded      = encoded;                        // store the value for next time
+  if (direction == 0) {                               // nothing to do if not a valid step,
+    ROTARY_STAT(if ((sum >> 2 ^ encoded) == 0b11) _Stats.illegal++);  // but count missed steps
+    ROTARY_STAT(StatsTime(start));
+    return;
+  }                                                   // of if-then not a valid step
+  ROTARY_STAT(_Stats.steps++);
+  if (_StepsPerDetent > 1) {                          // If counting whole detents, then
+    _DetentSteps += direction;                        // add up the transitions and
+    uint8_t offset = encoded ^ _DetentState;          // see if the pins are at a detent
+    if (offset != 0 && (_StepsPerDetent == 4 || offset != 0b11)) {
+      ROTARY_STAT(StatsTime(start));
+      return;                                         // Between detents, nothing to count yet
+    }                                                 // of if-then between detents
+    int8_t threshold = (_StepsPerDetent + 1) >> 1;    // Allow one missed transition
+    int8_t steps     = _DetentSteps;
+    _DetentSteps     = 0;                             // Start again at every detent
+    if (steps < threshold && steps > -threshold) {    // Back where it started
+      ROTARY_STAT(StatsTime(start));
+      return;
+    }                                                 // of if-then no whole detent
+    direction = steps > 0 ? 1 : -1;
+  }  // of if-then count whole detents
+  MoveValue(direction);
+  ROTARY_STAT(StatsTime(start));
+}  // of method RotateStep()
+void ROTARY_IRAM EncoderClass::CounterHandler() {
+  /*!
+    @brief     Read the hardware counter and update the encoder
+    @details   Called on every timer tick and before the value is read for encoders which are
+               counted by the hardware abstraction, see EncoderHAL::CounterBegin(). The counter
+               counts all 4 transitions of a step, so the transitions are added up as in
+               RotateStep() and one step is counted for every SetStepsPerDetent() transitions. The
+               remainder is kept for the next call. Must be called with interrupts disabled.
+    @return    void
+  */
+  int16_t steps = EncoderHAL::CounterSteps(_Counter);  // Transitions since the last call
+  if (steps == 0) return;                              // Nothing to do if not turned
+  ROTARY_STAT(_Stats.steps += steps > 0 ? steps : -steps);
+  int16_t pending = _DetentSteps + steps;              // Add the unused transitions
+  while (pending >= _StepsPerDetent) {                 // Count each whole clockwise
+    MoveValue(1);                                      // detent
+    pending -= _StepsPerDetent;
+  }                                                    // of while-loop clockwise detents
+  while (pending <= -(int16_t)_StepsPerDetent) {       // and each whole counterclockwise
+    MoveValue(-1);                                     // detent
+    pending += _StepsPerDetent;
+  }                                                    // of while-loop counterclockwise detents
+  _DetentSteps = pending;                              // Keep the rest for the next call
+}  // of method CounterHandler()
+void ROTARY_IRAM EncoderClass::MoveValue(const int8_t direction) {
+  /*!
+    @brief     Count one step of the encoder
+    @details   Called by RotateStep() and CounterHandler() for each decoded step. The new value is
+               kept within the range set with SetRange() and if it didn't move, because it is
+               already at a limit, nothing is reported. When wrapping, a step which is longer than
+               the range, as with acceleration on a short range, is taken modulo the range, and the
+               handler set with OnRotate() is given the net move along the range. The division is
+               only made for such steps.
+    @param[in] direction 1 for a clockwise step, -1 for a counterclockwise step
+    @return    void
+  */
+  uint8_t multiplier = UpdateVelocity(direction);             // Time the step, get step size
+  int32_t value      = _EncoderValue;                         // Current value
+  int16_t step       = direction > 0 ? multiplier : -(int16_t)multiplier;  // Signed change
+  int32_t next       = (int32_t)((uint32_t)value + step);     // New value, unsigned math
+  bool    wrapped    = (step > 0) != (next > value);          // wraps without overflowing
+  if (_Range) {                                               // Keep the value in the range
+    bool above = step > 0 && (wrapped || next > _RangeMax);   // Past the upper limit
+    bool below = step < 0 && (wrapped || next < _RangeMin);   // or past the lower limit
+    uint32_t span = (uint32_t)_RangeMax - (uint32_t)_RangeMin + 1;  // 0 for all 32 bits
+    if ((above || below) && (span != 0 || !_RangeWrap)) {     // A full range wraps by itself
+      wrapped = false;                                        // Not a 32-bit wrap
+      if (_RangeWrap) {                                       // Either go around to the
+        uint32_t length = step > 0 ? step : -step;            // other end, where the part of
+        uint32_t past   = length - 1 -                        // the step which is past the
+                        (above ? (uint32_t)_RangeMax - (uint32_t)value  // limit is taken
+                               : (uint32_t)value - (uint32_t)_RangeMin);  // modulo the range,
+        if (past >= span) past %= span;                       // so a step longer than the range
+        if (length >= span) length %= span;                   // still wraps, and report the
+        next = (int32_t)(above ? (uint32_t)_RangeMin + past : (uint32_t)_RangeMax - past);
+        step = step > 0 ? (int16_t)length : -(int16_t)length;  // net move along the range
+      } else {                                                // or stop at the limit
+        next = above ? _RangeMax : _RangeMin;
+        step = next - value;                                  // Part of the step which was made
+      }                                                       // of if-then-else wrap
+    }                                                         // of if-then outside of the range
+  }                                                           // of if-then range set
+  if (next == value) return;                                  // Nothing to report if no change
+  ROTARY_STAT(if (wrapped) _Stats.wraps++);                   // Count a 32-bit wrap
+  _EncoderValue = next;
+  if (_OnRotate != nullptr) _PendingDelta += step;            // Net change for the handler
+  _Direction = direction;                                     // remember the last direction
+  PushEvent(direction > 0 ? ENCODER_CW : ENCODER_CCW);        // Record the event
+  changed = true;                                             // Something has changed
+  if (direction > 0)                                          // Show the color of the
+    EventColor(_ColorCWR, _ColorCWG, _ColorCWB);              // clockwise turn
+  else                                                        // or of the
+    EventColor(_ColorCCWR, _ColorCCWG, _ColorCCWB);           // counterclockwise turn
+}  // of method MoveValue()
+uint8_t ROTARY_IRAM EncoderClass::UpdateVelocity(const int8_t Direction) {
+  /*!
+    @brief     Update the velocity estimate and return the acceleration multiplier
+    @details   Called from RotateHandler() for every valid step. The time since the previous step is
+               measured with micros() in units of 4 microseconds (the resolution of micros() on a
+               16MHz processor) and clamped to 16 bits. The step interval estimate is an exponential
+               moving average with a weight of 1/4 for the newest interval, which only needs shifts
+               and adds. A change of direction restarts the estimate at the slowest value so that
+               acceleration doesn't carry over into a reversal. The estimate is then compared to
+               the thresholds of the acceleration table, fastest entry first.
+    @param[in] Direction 1 for a clockwise step, -1 for a counterclockwise step
+    @return    Number of counts to add to or subtract from the encoder value for this step
+  */
+  uint32_t now     = micros();                           // Timestamp of this step
+  uint32_t elapsed = (now - _LastStepMicros) >> 2;       // Time since last step in 4us units
+  _LastStepMicros  = now;                                // Store for the next step
+  if (elapsed > 0xFFFF) elapsed = 0xFFFF;                // Clamp to 16 bits
+  if (Direction != _Direction)                           // A reversal restarts the estimate
+    _StepInterval = 0xFFFF;                              // at the slowest value
+  else
+    _StepInterval = _StepInterval - (_StepInterval >> 2) + ((uint16_t)elapsed >> 2);  // EMA of 1/4
+  for (uint8_t i = 0; i < _AccelEntries; i++) {          // Find the first threshold which the
+    if (_StepInterval < _Accel[i].interval) return _Accel[i].multiplier;  // interval is under
+  }                                                      // of for-next each acceleration entry
+  return 1;                                              // Single step if not accelerating
+}  // of method UpdateVelocity()
+int16_t EncoderClass::GetVelocity() {
+  /*!
+    @brief     Return the current rotation speed
+    @details   The smoothed step interval maintained by the rotate ISR is converted into steps per
+               second here, so the division isn't done in the interrupt. If the encoder has stopped
+               turning the time since the last step is used instead, so the velocity falls back to
+               zero instead of holding the last value.
+    @return    Signed steps per second, positive for clockwise and negative for counterclockwise
+  */
+  uint16_t interval;
+  uint32_t lastStep;
+  int8_t   direction;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // Copy the ISR values in one piece
+    interval  = _StepInterval;
+    lastStep  = _LastStepMicros;
+    direction = _Direction;
+  }                                                  // of atomic block
+  uint32_t idle = (micros() - lastStep) >> 2;        // Time since the last step in 4us units
+  if (idle < interval) idle = interval;              // Use the longer of the two
+  if (idle >= 0xFFFF) return 0;                      // Not turning if too long ago
+  uint32_t velocity = 250000UL / idle;               // Steps per second
+  if (velocity > INT16_MAX) velocity = INT16_MAX;    // Limit to the return type
+  return (direction < 0) ? -(int16_t)velocity : (int16_t)velocity;
+}  // of method GetVelocity()
+void EncoderClass::SetAcceleration(const bool Status) {
+  /*!
+    @brief     Turn acceleration with the default curve on or off
+    @details   The default curve multiplies each step by 2, 4, 8 or 16 when steps come faster than
+               every 16, 8, 4 or 2 milliseconds respectively
+    @param[in] Status true to turn acceleration on, false to turn it off
+    @return    void
+  */
+  static const EncoderAccel defaultCurve[] = {{2000, 16}, {4000, 8}, {8000, 4}, {16000, 2}};
+  if (Status)
+    SetAcceleration(defaultCurve, sizeof(defaultCurve) / sizeof(defaultCurve[0]));
+  else
+    SetAcceleration(nullptr, 0);
+}  // of method SetAcceleration()
+void EncoderClass::SetAcceleration(const EncoderAccel* Curve, uint8_t Entries) {
+  /*!
+    @brief     Set a custom acceleration curve
+    @details   The curve is a table of step intervals in microseconds and the multiplier to use when
+               the smoothed interval is shorter than that value. The entries must be sorted from the
+               shortest (fastest) interval to the longest. The table is copied and the intervals
+               converted to the 4 microsecond units used by the ISR, so the caller's table doesn't
+               need to be kept. At most ROTARY_ACCEL_ENTRIES entries are used.
+    @param[in] Curve   Array of acceleration entries, or nullptr to turn acceleration off
+    @param[in] Entries Number of entries in the array
+    @return    void
+  */
+  if (Curve == nullptr) Entries = 0;                             // No table means no acceleration
+  if (Entries > ROTARY_ACCEL_ENTRIES) Entries = ROTARY_ACCEL_ENTRIES;  // Limit to the table size
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {                            // Don't let the ISR see a
+    for (uint8_t i = 0; i < Entries; i++) {                      // partially copied table
+      _Accel[i].interval   = Curve[i].interval >> 2;
+      _Accel[i].multiplier = Curve[i].multiplier;
+    }  // of for-next each entry
+    _AccelEntries = Entries;
+  }  // of atomic block
+}  // of method SetAcceleration()
+void ROTARY_IRAM EncoderClass::PushEvent(const uint8_t Type) {
+  /*!
+    @brief     Add an event to the event ring buffer
+    @details   Only called from the interrupt handlers, which are the single producer for the
+               buffer. The indices are free running 8-bit counters, so the number of buffered events
+               is simply their difference. If the buffer is full the event is dropped and counted
+               rather than overwriting events which the main program hasn't read yet. The animation
+               of the event is started either way, sketches which never read the buffer still see
+               their animations.
+    @param[in] Type One of the EncoderEventType values
+    @return    void
+  */
+  if (_Animations[Type - 1] != nullptr) StartAnimation(_Animations[Type - 1]);  // Event trigger
+  uint8_t head = _EventHead;                                       // Local copy of the index
+  if ((uint8_t)(head - _EventTail) == ROTARY_EVENT_BUFFER_SIZE) {  // If the buffer is full then
+    _EventOverflows++;                                             // count the lost event
+    ROTARY_STAT(_Stats.overflows++);
+    return;
+  }  // of if-then buffer is full
+  volatile EncoderEvent& event = _Events[head & (ROTARY_EVENT_BUFFER_SIZE - 1)];
+  event.time                   = (uint16_t)millis();  // Store the timestamp
+  event.type                   = Type;                // and type of the event
+  _EventHead                   = head + 1;            // before publishing it
+}  // of method PushEvent()
+bool EncoderClass::PopEvent(EncoderEvent& Event) {
+  /*!
+    @brief      Get the oldest event from the event ring buffer
+    @details    The main program is the single consumer of the buffer. The event is copied out
+                before the read index is advanced so the slot can't be overwritten while being read.
+    @param[out] Event Structure to receive the event
+    @return     true if an event was returned, false if the buffer was empty
+  */
+  return PopEvents(&Event, 1) == 1;
+}  // of method PopEvent()
+uint8_t EncoderClass::PopEvents(EncoderEvent* Buffer, const uint8_t Size) {
+  /*!
+    @brief      Get up to Size events from the event ring buffer in one call
+    @details    Copies the oldest events into the caller's buffer and advances the read index once
+                at the end, so a batch costs only one update of the shared index
+    @param[out] Buffer Array to receive the events
+    @param[in]  Size   Number of entries in Buffer
+    @return     Number of events copied into the buffer
+  */
+  uint8_t tail  = _EventTail;            // Local copies of the volatile indices
+  uint8_t count = _EventHead - tail;     // Number of events in the buffer
+  if (count > Size) count = Size;        // Limit to what the caller can take
+  for (uint8_t i = 0; i < count; i++) {  // Copy each event out of the buffer
+    volatile EncoderEvent& event = _Events[(uint8_t)(tail + i) & (ROTARY_EVENT_BUFFER_SIZE - 1)];
+    Buffer[i].time               = event.time;
+    Buffer[i].type               = event.type;
+  }                           // of for-next each event
+  _EventTail = tail + count;  // Release the slots to the ISRs
+  return count;
+}  // of method PopEvents()
+uint16_t EncoderClass::GetEventOverflows() {
+  /*!
+    @brief     Return the number of events lost because the event buffer was full
+    @return    unsigned 16 bit count of dropped events
+  */
+  uint16_t returnValue;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { returnValue = _EventOverflows; }  // 16 bit read is atomic
+  return (returnValue);
+}  // of method GetEventOverflows()
+EncoderStats EncoderClass::GetStats() {
+  /*!
+    @brief     Return a copy of the statistics
+    @details   The counters are only kept when the library is compiled with ROTARY_ENCODER_STATS
+               set to 1, otherwise all of them are returned as 0. The copy is made with interrupts
+               disabled, so all values are from the same moment.
+    @return    EncoderStats structure
+  */
+  EncoderStats stats = {0, 0, 0, 0, 0, 0, 0};
+#if ROTARY_ENCODER_STATS
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { stats = _Stats; }  // Consistent copy of all counters
+#endif
+  return stats;
+}  // of method GetStats()
+void EncoderClass::ResetStats() {
+  /*!
+    @brief     Reset all statistics counters to 0
+    @return    void
+  */
+#if ROTARY_ENCODER_STATS
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { _Stats = {0, 0, 0, 0, 0, 0, 0}; }
+#endif
+}  // of method ResetStats()
+#if ROTARY_ENCODER_STATS
+uint32_t ROTARY_IRAM EncoderClass::StatsClock() {
+  /*!
+    @brief     Return the current value of the free running clock of the statistics
+    @details   The Timer0 counter on an AVR, which counts once every 64 CPU cycles, and the CPU
+               cycle counter on an ESP32
+    @return    Clock value, see EncoderHAL::CycleCount()
+  */
+  return EncoderHAL::CycleCount();
+}  // of method StatsClock()
+void ROTARY_IRAM EncoderClass::StatsTime(const uint32_t Start) {
+  /*!
+    @brief     Record the run time of a handler if it is the longest so far
+    @param[in] Start Clock value returned by StatsClock() when the handler started
+    @return    void
+  */
+  uint16_t cycles = EncoderHAL::CyclesSince(Start);  // Cycles in the resolution of the backend
+  if (cycles > _Stats.peakCycles) _Stats.peakCycles = cycles;
+}  // of method StatsTime()
+#endif
 uint8_t EncoderClass::GetButton() {
   /*!
     @brief   Return button pushes
     @details Returns number of button pushes since the last call and resets the value
     @return  unsigned integer number of button pushes
   */
-  uint8_t returnValue = _ButtonPresses;  // Set the return value
-  _ButtonPresses      = 0;               // reset value
+  EncoderHAL::TimerRetry();  // Start a tick which the constructor couldn't start
+  uint8_t returnValue;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // Read and clear without an ISR in between
+    returnValue    = _ButtonPresses;   // Set the return value
+    _ButtonPresses = 0;                // reset value
+  }                                    // of atomic block
   return (returnValue);
 }  // of method GetButton()
 void EncoderClass::SetColor(const uint8_t R, const uint8_t G, const uint8_t B) {
   /*!
     @brief     Sets the RGB LED values
-    @details   Called to set the RGB values to set when the button is pushed
+    @details   The LEDs are set to the color immediately and, if fading is turned on, then fade
+               back to off at the configured fade rate
     @param[in] R Red value
     @param[in] G Green value
     @param[in] B Blue value
     @return    void
   */
-  _RedActual   = R;                        // set internal values
-  _GreenActual = G;                        // set internal values
-  _BlueActual  = B;                        // set internal values
-  _RedTarget   = R;                        // set internal values
-  _GreenTarget = G;                        // set internal values
-  _BlueTarget  = B;                        // set internal values
-  _LEDChanged  = true;                     // Mark that we have a change
-  if (_FadeMillis == 0) {                  // Manually set if no fade
-    analogWrite(_RedPin, _RedTarget);      // show the Red,
-    analogWrite(_GreenPin, _GreenTarget);  // Green, and
-    analogWrite(_BluePin, _BlueTarget);    // Blue values
-  }                                        // of if fading is turned off
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // Don't let the timer see half a change
+    _Program       = nullptr;           // Stop any animation
+    _RedActual     = (uint16_t)R << 8;  // set internal values
+    _GreenActual   = (uint16_t)G << 8;  // set internal values
+    _BlueActual    = (uint16_t)B << 8;  // set internal values
+    _RedTarget     = R;                 // set internal values
+    _GreenTarget   = G;                 // set internal values
+    _BlueTarget    = B;                 // set internal values
+    _RedStep       = 0;                 // Hold the color for one tick,
+    _GreenStep     = 0;                 // after which the fade back
+    _BlueStep      = 0;                 // to off is started
+    _FadeTicksLeft = 1;
+    _LEDChanged    = false;
+    if (_FadeTicks) ArmTimer();         // Start the fader if it was idle
+  }                                     // of atomic block
+  ShowColor(R, G, B);  // Show the color right away
 }  // of method SetColor
 void EncoderClass::SetPushButtonColor(const uint8_t R, const uint8_t G, const uint8_t B) {
   /*!
@@ -265,60 +1250,338 @@ void EncoderClass::SetLEDState(const bool Status) {
     @param[in] Status boolean value for on or off
     @return    void
   */
-  _LEDOn = Status;              // Set the internal switch variable
-  if (!Status) {                // if we are turning off the LEDs
-    analogWrite(_RedPin, 255);  // ensure everything is turned off
-    analogWrite(_GreenPin, 255);
-    analogWrite(_BluePin, 255);
-  }  // of if-then we are turning LEDs off
+  _LEDOn = Status;                      // Set the internal switch variable
+  if (!Status) {                        // if we are turning off the LEDs
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // ensure everything is turned off,
+      WritePWM(255, 255, 255);           // without the fader writing at the same time
+      _Program = nullptr;                // and stop any animation
+    }                                    // of atomic block
+  }                                      // of if-then we are turning LEDs off
 }  // of method SetLEDState()
 int16_t EncoderClass::GetEncoderValue() {
   /*!
     @brief     Return the current rotation value of the encoder
+    @details   Only the lower 16 bits are returned, use GetEncoderValue32() for the full value
     @return    signed 16 bit integer value
   */
-  return (_EncoderValue);  // Return the current value
+  return (GetEncoderValue32());  // Return the current value
 }  // of method GetEncoderValue()
-void EncoderClass::SetEncoderValue(const int16_t NewValue) {
+int32_t EncoderClass::GetEncoderValue32() {
+  /*!
+    @brief     Return the current rotation value of the encoder
+    @details   The 4 bytes are copied with interrupts disabled so that a rotate interrupt can't
+               change the value halfway through the read
+    @return    signed 32 bit integer value
+  */
+  EncoderHAL::TimerRetry();  // Start a tick which the constructor couldn't start
+  int32_t returnValue;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (_Counter != ROTARY_NO_COUNTER) CounterHandler();  // Pick up the latest counted steps
+    returnValue = _EncoderValue;                          // Copy in one piece
+  }                                                       // of atomic block
+  return (returnValue);
+}  // of method GetEncoderValue32()
+int32_t EncoderClass::GetAndResetDelta() {
+  /*!
+    @brief     Return the change of the encoder value since the last call
+    @details   Only the value read needs interrupts disabled, the reference value is only used by
+               the main program. The encoder value itself is left unchanged.
+    @return    signed 32 bit number of steps since the last call
+  */
+  int32_t value = GetEncoderValue32();  // Atomic copy of the value
+  int32_t delta = value - _DeltaBase;   // Change since last time
+  _DeltaBase    = value;                // New reference value
+  return (delta);
+}  // of method GetAndResetDelta()
+void EncoderClass::OnRotate(EncoderRotateHandler Handler) {
+  /*!
+    @brief     Register the handler called by Service() after the encoder has been turned
+    @details   The steps made since the last Service() call are added up in the interrupt handler
+               and the handler is called once with the net change, including any acceleration. A
+               turn back and forth which ends where it started doesn't call the handler.
+    @param[in] Handler Function called as Handler(Encoder, Delta), nullptr to remove it
+    @return    void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _OnRotate     = Handler;
+    _PendingDelta = 0;  // Only count steps from now on
+  }                     // of atomic block
+}  // of method OnRotate()
+void EncoderClass::OnPush(EncoderPushHandler Handler) {
+  /*!
+    @brief     Register the handler called by Service() after the pushbutton has been pressed
+    @details   The handler is called once with the number of presses since the last Service() call.
+               The presses are still counted for GetButton() as well.
+    @param[in] Handler Function called as Handler(Encoder, Presses), nullptr to remove it
+    @return    void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _OnPush        = Handler;
+    _PendingPushes = 0;  // Only count presses from now on
+  }                      // of atomic block
+}  // of method OnPush()
+void EncoderClass::OnFadeComplete(EncoderFadeHandler Handler) {
+  /*!
+    @brief     Register the handler called by Service() once the LEDs have faded back to off
+    @details   Only fades started by the timer are reported, so nothing is reported while fading is
+               turned off with SetFadeRate(0)
+    @param[in] Handler Function called as Handler(Encoder), nullptr to remove it
+    @return    void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _OnFade      = Handler;
+    _PendingFade = false;
+  }  // of atomic block
+}  // of method OnFadeComplete()
+bool EncoderClass::Service() {
+  /*!
+    @brief   Call the registered handlers for everything which happened since the last call
+    @details The interrupt handlers only record the pending work, this function copies and clears
+             it in one short atomic block and then calls the handlers with interrupts enabled, so
+             user code never runs in interrupt context and a slow handler doesn't delay the
+             encoder. Calling this at the start of loop() replaces checking "changed",
+             GetEncoderValue() and GetButton() on every pass. The handlers are called in the order
+             rotate, push and fade complete.
+    @return  true if any handler was called
+  */
+  EncoderHAL::TimerRetry();  // Start a tick which the constructor couldn't start
+  int32_t delta;
+  uint8_t pushes;
+  bool    fade;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // Take over the pending work
+    delta          = _PendingDelta;
+    pushes         = _PendingPushes;
+    fade           = _PendingFade;
+    _PendingDelta  = 0;
+    _PendingPushes = 0;
+    _PendingFade   = false;
+  }  // of atomic block
+  if (delta != 0 && _OnRotate != nullptr) _OnRotate(*this, delta);
+  if (pushes != 0 && _OnPush != nullptr) _OnPush(*this, pushes);
+  if (fade && _OnFade != nullptr) _OnFade(*this);
+  return delta != 0 || pushes != 0 || fade;
+}  // of method Service()
+EncoderSnapshot EncoderClass::Snapshot() {
+  /*!
+    @brief     Return a consistent copy of the encoder state
+    @details   The encoder value, number of button pushes and the last rotation direction are all
+               copied in the same atomic block so they belong together. The button pushes are not
+               reset, use GetButton() to read and clear them.
+    @return    EncoderSnapshot structure
+  */
+  EncoderHAL::TimerRetry();  // Start a tick which the constructor couldn't start
+  EncoderSnapshot returnValue;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // Copy everything in one piece
+    if (_Counter != ROTARY_NO_COUNTER) CounterHandler();  // Pick up the latest counted steps
+    returnValue.position  = _EncoderValue;
+    returnValue.presses   = _ButtonPresses;
+    returnValue.direction = _Direction;
+  }  // of atomic block
+  return (returnValue);
+}  // of method Snapshot()
+void EncoderClass::SetEncoderValue(const int32_t NewValue) {
   /*!
   @brief     Set the internal encoder variables
-  @param[in] NewValue signed int16 value
+  @details   The reference value for GetAndResetDelta() is set as well, so the next delta is
+             relative to the new value. Steps still waiting in a hardware counter are taken first,
+             so that they don't move the new value on the next timer tick.
+  @param[in] NewValue signed int32 value
   @return    void
 */
-
-  _EncoderValue = NewValue;  // Set the new value
+  int32_t value = NewValue;
+  if (_Range) value = value > _RangeMax ? _RangeMax : value < _RangeMin ? _RangeMin : value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (_Counter != ROTARY_NO_COUNTER) CounterHandler();  // Take the steps made before
+    _EncoderValue = value;                                // and set the new value
+  }                                                       // of atomic block
+  _DeltaBase = value;                                             // and the delta reference
 }  // of method SetEncoderValue()
+void EncoderClass::SetStepsPerDetent(const uint8_t Steps) {
+  /*!
+    @brief     Set the number of quadrature transitions counted as one step
+    @details   Most encoders have 4 transitions from one detent to the next, which by default are
+               all counted (x4 resolution). With 2 the value changes twice per detent (x2) and with
+               4 once per detent (x1), and the "changed" flag, the events and the LED colors only
+               follow the counted steps. The pins must be at rest in a detent when this is called,
+               as their state is taken as the detent state. The velocity and acceleration are
+               measured in counted steps.
+    @param[in] Steps 1, 2 or 4 transitions per step, other values are ignored
+    @return    void
+  */
+  if (Steps != 1 && Steps != 2 && Steps != 4) return;
+  uint8_t state = ((*_LeftPort & _LeftMask) ? 0b10 : 0) | ((*_RightPort & _RightMask) ? 0b01 : 0);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _StepsPerDetent = Steps;
+    _DetentState    = state;  // The detent the pins are resting in
+    _DetentSteps    = 0;
+  }  // of atomic block
+}  // of method SetStepsPerDetent()
+void EncoderClass::SetRange(const int32_t Min, const int32_t Max, const bool Wrap) {
+  /*!
+    @brief     Limit the encoder value to a range
+    @details   The limits are applied in the rotate interrupt. Turning past a limit either stops at
+               the limit or, with Wrap set, continues from the other end. A step at a limit which
+               doesn't change the value isn't reported. The current value is moved into the range.
+               Setting Max below Min turns the range off. Any range up to the full 32 bits works,
+               the span is computed unsigned in the rotate interrupt.
+    @param[in] Min  Lowest value
+    @param[in] Max  Highest value
+    @param[in] Wrap true to wrap around, false to stop at the limits
+    @return    void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _Range     = Max >= Min;
+    _RangeMin  = Min;
+    _RangeMax  = Max;
+    _RangeWrap = Wrap;
+    if (_Range && _EncoderValue > Max) _EncoderValue = Max;  // Move the value
+    if (_Range && _EncoderValue < Min) _EncoderValue = Min;  // into the range
+  }                                                          // of atomic block
+}  // of method SetRange()
 void EncoderClass::SetFadeRate(const uint8_t FadeSpeed) {
   /*!
   @brief     Turn the fade functionality on or off and adjust the rate at which the fade occurs
-  @details   The fade is done by accessing the Timer0 interrupt, which is used by the millis()
-             function and is an 8-bit register with a clock divisor of 64 which triggers it to
-             overflow at a rate of 976.5625Hz, or roughly every millisecond. We set the
-             TIMER0_COMPA_vect to 0x01 which triggers when the value is equal to 64. This then gives
-             us an identical trigger speed but different trigger point to the millis() function
-             which triggers when the Timer0 overflows. The same setup is done for the
-             TIMER0_COMPB_vect but that is set to trigger halfway along the full range of 255 at
-             192, thus giving an interrupt rate of 2 times per milli second. The FadeSpeed equates
-             to how many milliseconds there are between incremental fades, the fastest is 1 which is
-             every 1/2 millisecond, 2 is every millisecond, etc. Each time the trigger is reached
-             all of the LED values which are not "off" are dimmed by 1/255 of the total value. A
-             setting of 10 would fade the LEDs from full on to OFF 1/255 of their brightness in 1.28
-             seconds
-  @param[in] FadeSpeed unsigned 8bit integer. 1 is every 1/2ms, 2 is 1ms, 3 is 2ms and so on
+  @details   Kept for compatibility, the fade length is now set in timer ticks of 1/2 millisecond
+             using SetFadeTicks(). A FadeSpeed of 1 fades from full on to off in 255 ticks, or 127.5
+             milliseconds, and each further increment of FadeSpeed adds the same time again. A
+             setting of 10 would fade the LEDs from full on to off in 1.28 seconds.
+  @param[in] FadeSpeed unsigned 8bit integer. 0 is off, 1 is fastest
+  @return    void
+*/
+  SetFadeTicks((uint16_t)FadeSpeed * 255);  // 255 ticks per unit of FadeSpeed
+}  // of method SetFadeRate()
+void EncoderClass::SetFadeTime(const uint16_t Millis) {
+  /*!
+  @brief     Set the time it takes to fade to a new color and back to off
+  @details   Each of the two fades takes the given time, regardless of how far the colors are
+             apart. Times are rounded to the 1/2 millisecond timer tick and are limited to 32767ms.
+  @param[in] Millis Fade time in milliseconds, 0 turns fading off
   @return    void
 */
-  _FadeMillis = FadeSpeed;   // Set the private variable to value
-  if (FadeSpeed) {           // If turning on, set the ISR
-    cli();                   // Disable interrupts
-    OCR0A = 0x40;            // Comparison register A to 64
-    OCR0B = 0xC0;            // Comparison register B to 192
-    TIMSK0 |= _BV(OCIE0A);   // TIMER0_COMPA trigger on 0x01
-    TIMSK0 |= _BV(OCIE0B);   // TIMER0_COMPB trigger on 0x80
-    sei();                   // Enable interrupts
-  } else {                   // If turning off, unset the ISR
-    cli();                   // Disable interrupts
-    TIMSK0 &= ~_BV(OCIE0A);  // TIMER0_COMPA trigger off
-    TIMSK0 &= ~_BV(OCIE0B);  // TIMER0_COMPB trigger off
-    sei();                   // Enable interrupts
-  }                          // of if-then-else we need to turn fading on or off
-}  // of method SetFadeRate
+  SetFadeTicks(Millis > 32767 ? 65534 : Millis * 2);  // 2 ticks per millisecond
+}  // of method SetFadeTime()
+void EncoderClass::SetFadeTicks(uint16_t Ticks) {
+  /*!
+  @brief     Set the fade length in timer ticks and turn the timer interrupts on or off
+  @details   The fade is done in the Timer0 compare interrupts, see ArmTimer(). They are turned on
+             here when fading is turned on and the timer handler turns them off again as soon as
+             all fades are complete, so turning fading off needs no action here. The reciprocal of
+             the fade length is computed here, outside of the interrupt, as a 24-bit fixed point
+             fraction so that the timer handler only needs multiplications.
+  @param[in] Ticks Number of 1/2 millisecond ticks per fade, 0 turns fading off
+  @return    void
+*/
+  if (Ticks == 1) Ticks = 2;                        // Keep the steps in 16 bits
+  uint32_t recip = Ticks ? 0xFFFFFFUL / Ticks : 0;  // 24-bit reciprocal of the fade length
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {               // Change both values together
+    _FadeTicks = Ticks;
+    _FadeRecip = recip;
+    if (Ticks) ArmTimer();                          // The timer turns itself off when idle
+  }                                                 // of atomic block
+}  // of method SetFadeTicks()
+void EncoderClass::SetGamma(const bool Status) {
+  /*!
+  @brief     Turn gamma correction of the LED values on or off
+  @details   With gamma correction on the PWM values are looked up in a table stored in program
+             memory so that a fade, which changes the values linearly, also looks linear to the eye
+  @param[in] Status true to turn gamma correction on
+  @return    void
+*/
+  _Gamma = Status;
+}  // of method SetGamma()
+bool EncoderClass::UsePinChangeWake() {
+  /*!
+    @brief   Record that the sketch has defined the pin change interrupt vectors
+    @details Called by the ROTARY_ENCODER_PCINT_VECTORS macro. Sleep() only turns on the pin change
+             interrupts and uses the power-down mode once the vectors are known to exist.
+    @return  true
+  */
+  _PinChangeWake = true;
+  return true;
+}  // of method UsePinChangeWake()
+void EncoderClass::PinChangeISR() {
+  /*!
+    @brief   Handler for the pin change interrupts used to wake up from power-down
+    @details In power-down mode the clock for the edge detection of the external interrupts is
+             stopped, so the edge which wakes the processor is only seen by the pin change
+             interrupt. The rotate handler of every instance is called, which does nothing when the
+             pins of that encoder haven't changed, and a pushbutton which reads as pressed is passed
+             to the pushbutton handler, whose lockout time stops a press being counted twice. This
+             is only done while powered down, at other times the pin change interrupts belong to
+             the scanners in pin change mode, which are always scanned.
+  */
+  if (_PoweredDown) {  // Only the wake-up edge is missed by the pin interrupts
+    for (uint8_t i = 0; i < ROTARY_MAX_ENCODERS; i++) {
+      EncoderClass* instance = _Instances[i];
+      if (instance == nullptr) continue;
+      if (instance->_Counter == ROTARY_NO_COUNTER) instance->RotateHandler();
+      if (*instance->_ButtonPort & instance->_ButtonMask) instance->PushButtonHandler();
+    }  // of for-next each registry slot
+    _PoweredDown = false;
+  }  // of if-then woken from power-down
+#if defined(ROTARY_HAL_BYTE_PORTS)
+  EncoderScanner::ScanAll(false);  // Scanners in pin change mode
+#endif
+}  // of method PinChangeISR()
+bool EncoderClass::SetPinChangeMasks(const bool Enable) {
+  /*!
+    @brief     Turn the pin change interrupts of all encoder pins on or off
+    @details   If any of the pins has no pin change interrupt then none are left turned on, since
+               that pin couldn't wake the processor from power-down
+    @param[in] Enable true to turn the pin change interrupts on, false to turn them off
+    @return    true if every pin has a pin change interrupt
+  */
+  bool complete = true;  // Cleared when a pin has no pin change interrupt
+#if defined(digitalPinToPCICR)
+  for (uint8_t i = 0; i < ROTARY_MAX_ENCODERS; i++) {
+    if (_Instances[i] == nullptr) continue;
+    const uint8_t pins[3] = {_Instances[i]->_LeftPin, _Instances[i]->_RightPin,
+                             _Instances[i]->_PushbuttonPin};
+    for (uint8_t p = 0; p < 3; p++) {
+      if (digitalPinToPCICR(pins[p]) == 0) {  // If the pin has no pin change interrupt,
+        complete = false;                     // then remember that and skip it
+        continue;
+      }  // of if-then no pin change interrupt
+      if (Enable) {
+        PCIFR = _BV(digitalPinToPCICRbit(pins[p]));                          // Clear old requests
+        *digitalPinToPCMSK(pins[p]) |= _BV(digitalPinToPCMSKbit(pins[p]));   // Enable the pin
+        *digitalPinToPCICR(pins[p]) |= _BV(digitalPinToPCICRbit(pins[p]));   // and its group
+      } else {
+        *digitalPinToPCMSK(pins[p]) &= ~_BV(digitalPinToPCMSKbit(pins[p]));  // Disable the pin
+      }  // of if-then-else turn on or off
+    }    // of for-next each pin
+  }      // of for-next each registry slot
+  if (Enable && !complete) SetPinChangeMasks(false);  // Turn them all off again
+#else
+  (void)Enable;
+  complete = false;  // No pin change interrupts on this processor
+#endif
+  return complete;
+}  // of method SetPinChangeMasks()
+void EncoderClass::Sleep() {
+  /*!
+    @brief   Put the processor to sleep until the next interrupt
+    @details While the LEDs are fading the Timer0 compare interrupts are needed, so the idle sleep
+             mode is used, which keeps the timers running and wakes on the next timer tick or
+             encoder interrupt. Once all fades are complete and the sketch contains the
+             ROTARY_ENCODER_PCINT_VECTORS macro, the pin change interrupts of all encoder pins are
+             turned on and the power-down mode is used until the encoder is turned or the button
+             is pushed. The millis() counter doesn't advance while powered down. If any pin has no
+             pin change interrupt the idle mode is used instead. On processors other than AVR this
+             function returns immediately.
+    @return  void
+  */
+#if defined(__AVR__)
+  bool powerDown = _PinChangeWake && !EncoderHAL::TimerRunning();  // Fader idle?
+  if (powerDown) powerDown = SetPinChangeMasks(true);  // Only if every pin can wake us
+  set_sleep_mode(powerDown ? SLEEP_MODE_PWR_DOWN : SLEEP_MODE_IDLE);
+  cli();                                    // Disable interrupts
+  _PoweredDown = powerDown;                 // Let PinChangeISR() handle the wake-up edge
+  sleep_enable();                           // Allow sleeping
+  sei();                                    // The instruction after sei() is always executed,
+  sleep_cpu();                              // so no interrupt is missed before sleeping
+  sleep_disable();                          // Woken up by an interrupt
+  _PoweredDown = false;
+  if (powerDown) SetPinChangeMasks(false);  // Only needed to wake up
+#endif
+}  // of method Sleep()
@@ -20,11 +20,139 @@ Each Atmel processor has different pins available for interrupts, so the choice
 the ROTARY_PIN_1, ROTARY_PIN_2 and PUSHBUTTON_PIN is quite limited. A good description of the pins
 and their uses can be found at https://www.arduino.cc/en/Reference/AttachInterrupt.
 
-The library uses the Arduino functions "digitalRead()" to get pin state in the interrupt handlers.
-These are relatively slow compared to the direct register reading methods available. Since the
-library is designed for a hand-turned encoder versus a high-speed machine with thousands of RPM the
-slower functions have been retained for more portability and legibility. Going directly to the
-PORTA, PORTB, etc. register reads would make the pin mapping that needs to be done too complex.
+Up to ROTARY_MAX_ENCODERS (default 4) encoders can be active at the same time. Each instance takes a
+slot in a static registry and is given its own set of interrupt trampolines, so the pin interrupts
+of one encoder are always routed to the object that owns those pins. The Timer0 fade interrupt is
+shared and services the LEDs of all registered instances in a single pass.
+
+The ROTARY_MAX_ENCODERS, ROTARY_EVENT_BUFFER_SIZE, ROTARY_ACCEL_ENTRIES, ROTARY_MAX_SCANNERS and
+ROTARY_ENCODER_STATS settings change the layout of the classes, so they must have the same value in
+every file which is compiled. The Arduino IDE compiles the library files separately from the sketch,
+so a #define in the sketch is not enough; either change the defaults in this header or set them as
+compiler flags for the whole build.
+
+Besides the "changed" flag and the accumulated encoder value, every rotation step and pushbutton
+press is recorded as a small timestamped EncoderEvent in a per-instance ring buffer. The interrupt
+handlers are the only writers and the main program the only reader, so no locking is needed. The
+events are read with PopEvent() or, in batches, with PopEvents(). If the buffer is full the new
+event is dropped and counted, and the count can be read with GetEventOverflows().
+
+The encoder value is a 32-bit number which the interrupt handlers may change at any time. An 8-bit
+processor needs several instructions to read it, so all of the accessors copy it with interrupts
+briefly disabled to avoid returning a half-updated value. GetEncoderValue() returns the lower 16
+bits for compatibility, GetEncoderValue32() the full value, GetAndResetDelta() the change since its
+last call and Snapshot() returns a consistent copy of the value, button count and last direction.
+
+Each valid step is timestamped in the rotate interrupt and a smoothed step interval is kept using
+integer shifts and adds only. GetVelocity() converts this into signed steps per second. When
+acceleration is turned on with SetAcceleration() the interval is compared to a small table of
+thresholds and fast turns add a multiple of the step to the encoder value, so large ranges can be
+covered quickly while slow turns still move by single steps.
+
+The LED fading is driven by the Timer0 compare interrupts every 1/2 millisecond. Each LED level is
+kept as an 8.8 fixed point number and a fade adds a precomputed step on each tick, so a fade to any
+color takes the same time, which is set with SetFadeTime() in milliseconds (SetFadeRate() is still
+available). Optionally the output values can be gamma corrected with a table in program memory,
+turned on with SetGamma(), so that fades look linear to the eye.
+
+The Timer0 compare interrupts are only turned on while something is fading. Once all of the LEDs
+have reached their targets the timer handler turns them off, and the next rotation, button push or
+SetColor() call turns them on again, so an idle encoder uses no CPU time. The static Sleep()
+function puts the processor to sleep until the next interrupt and can be called at the end of
+loop(). If the sketch contains the line "ROTARY_ENCODER_PCINT_VECTORS" outside of any function, the
+library defines the pin change interrupt vectors and Sleep() uses the power-down mode while the LEDs
+are idle, waking up when any encoder pin changes. This can't be combined with other code which uses
+pin change interrupts, such as SoftwareSerial.
+
+The PWM compare register of each LED pin is looked up once in the class constructor and only the
+channels whose value has changed are written, which during a fade is usually only one or two of
+them. analogWrite() is still used for the values 0 and 255, which switch the PWM output off, and
+for pins whose compare register isn't known.
+
+When the pins are known when the sketch is written, the RotaryEncoder template in
+"RotaryEncoderTemplate.h" can be used instead of EncoderClass, for example
+"RotaryEncoder<2, 3, 4, 9, 10, 11> encoder;". It has the same functions as EncoderClass, but its
+interrupt trampolines call the instance directly instead of through the registry and, on the
+ATmega328P and ATmega168, read the encoder pins from compile-time PINx addresses instead of through
+the pointers looked up by the constructor. The LED writer is chosen from the constant LED pins as
+well, so an encoder without LEDs writes nothing.
+
+The pushbutton can be on any pin. A pin without an external interrupt, such as pin 4 of an Arduino
+Uno, is sampled and debounced on the timer tick in the same way as in polling mode, which keeps the
+timer tick running all of the time.
+
+Encoders which bounce badly can be switched to polling mode with SetPolling(). The pin interrupts
+are then detached and the pins are sampled on every timer tick and debounced with an integrator per
+pin, so the interrupt load is fixed at 2000 samples a second no matter how much the contacts bounce.
+
+With SetGestures() the pushbutton interrupt, which now sees both edges, and the timer tick drive a
+small state machine which adds ENCODER_CLICK, ENCODER_DOUBLE, ENCODER_LONG and ENCODER_REPEAT
+events to the event buffer, so that the sketch doesn't have to time the button itself. The times
+are set with SetGestureTimes(), by default a long press is 600ms, a double click must follow within
+300ms and a held button repeats every 200ms. The button is debounced on the timer tick and the timer
+only runs while the button is pressed or a gesture is pending.
+
+Encoders with several transitions per detent can be set to count whole detents with
+SetStepsPerDetent() (x1, x2 or the default x4 resolution) and the value can be limited with
+SetRange(), either stopping at the limits or wrapping around. Both are done in the rotate interrupt,
+so the "changed" flag, the events and the handlers only see steps which really moved the value and
+the main program never has to divide, clamp or wrap the value while the interrupt changes it.
+
+Richer LED effects such as a pulse or a breathing color are played from keyframe programs stored
+in program memory. Each keyframe fades to a color in a given time, and loop and end keyframes allow
+repeating sections. Counted loops can follow each other but can't be nested, since there is only one
+repeat counter, while a loop without a count can enclose counted ones. An animation is started by
+an event type with SetAnimation() or right away with PlayAnimation(), and is advanced entirely by
+the timer tick with the same fixed point fade engine, so it needs no time in loop() and only a few
+bytes of RAM for its position, for example:
+
+    const EncoderKeyframe Pulse[] PROGMEM = {
+        ROTARY_KEYFRAME(0, 255, 255, 100),    // Fade to red in 100ms
+        ROTARY_KEYFRAME(255, 255, 255, 400),  // and back to off in 400ms,
+        ROTARY_LOOP(0, 2),                    // repeated twice more
+        ROTARY_END};
+    Encoder.SetAnimation(ENCODER_PUSH, Pulse);
+
+Instead of checking "changed" on every pass through loop(), handlers can be registered with
+OnRotate(), OnPush() and OnFadeComplete(). The interrupt handlers only record the pending work,
+adding up the steps to a net change, and Service(), called from loop(), calls the handlers in one
+batch. The handlers therefore run as normal code and never in interrupt context, and a fast turn
+results in a single call of the rotate handler with the net change rather than one call per step.
+
+When the library is compiled with ROTARY_ENCODER_STATS set to 1, every instance keeps a set of
+health counters: valid steps, transitions where both pins changed (missed steps), button pushes
+ignored as bounces, fade ticks, event buffer overflows and wrap-arounds of the encoder value, as
+well as the longest run time of the interrupt handlers in CPU cycles. The run time is measured with
+the Timer0 counter in steps of 64 cycles on an AVR and with the CPU cycle counter on an ESP32, where
+it is limited to 65535 cycles. The counters are read with GetStats() and cleared with ResetStats(),
+which tells a marginal encoder apart from an overloaded processor. The counters cost a few cycles
+per interrupt, so they are off by default.
+
+Several plain encoders wired to the same port can be read with an EncoderScanner, see
+"RotaryEncoderScanner.h". It reads the port once and decodes up to 4 encoders in parallel, either
+from the pin change interrupt or from the timer tick.
+
+The encoder value and the pushbutton and turn colors can be kept over a power loss with an
+EncoderStore, see "RotaryEncoderStore.h". It saves the state in the EEPROM once the encoder has
+been idle for a while, spreads the records over a ring of slots to limit the wear and writes the
+bytes in the background from the EEPROM ready interrupt. Restore() applies the newest record.
+
+Everything which depends on the processor, the timer tick, the PWM registers of the LEDs and the
+decoding of the encoder pins, goes through the EncoderHAL class of "RotaryEncoderHAL.h", whose
+backend is chosen at compile time. The AVR backend is described above. On the ESP32 each encoder is
+counted in hardware by a pulse counter (PCNT) unit, so no interrupts are used for the encoder pins;
+the timer tick reads the counter and passes the steps to the same code as the rotate interrupt, so
+acceleration, detents, ranges, events and LED colors work as before, and GetEncoderValue() reads the
+counter register before returning the value. The third backend runs the library on the host with
+the simulation described below. The EncoderScanner, Sleep() and the RotaryEncoder template's
+compile-time pin reads remain AVR (and host) only.
+
+The rotation interrupt handler reads the encoder pins directly from their PINx registers. The port
+register address and the bit mask for each pin are looked up once in the class constructor using
+the standard Arduino "digitalPinToPort()" and "digitalPinToBitMask()" macros, so the pin mapping is
+still done by the Arduino core but the slow "digitalRead()" calls are no longer made on every edge.
+The quadrature decoding itself is a lookup into a 16-entry transition table instead of a chain of
+comparisons, which keeps the time spent in the interrupt short even when the encoder is spun fast.
 
 The rotary encoder has a common cathode (+) for the 3 LED lights. The pins for the 3 colors need to
 be attached to any 3 available PWM pins (not all of the Atmel pins are PWM, see
@@ -46,6 +174,13 @@ allowing the code to be printed in A4 landscape mode. There are several parts of
 somewhat optimized, but in order to make the c++ code more understandable by non-programmers some
 performance has been sacrificed for legibility and maintainability.
 
+@section simulation Host simulation
+When the library is compiled outside of the Arduino environment, i.e. when the "ARDUINO" macro isn't
+defined, the file "RotaryEncoderSim.h" is included in place of "Arduino.h". It provides the few
+Arduino and AVR functions and registers used by the library along with the EncoderSimulator class,
+which sets pin levels, advances time and replays recorded or generated waveforms so the interrupt
+handlers can be run, timed and checked on a desktop computer. See that file for details.
+
 @section doxygen configuration
 This library is built with the standard "Doxyfile", which is located at
 https://github.com/Zanduino/Common/blob/main/Doxygen. As described on that page, there are only 5
@@ -81,6 +216,25 @@ Written by Arnd <Arnd@Zanduino.Com> at https://www.github.com/SV-Zanshin
 
 | Version | Date       | Developer  | Comments
 | ------- | ---------- |------------| --------------------------------------------------------------
+| 1.1.17  | 2026-10-16 | SV-Zanshin | Added EncoderStore to save the value and colors in the EEPROM
+| 1.1.16  | 2026-10-16 | SV-Zanshin | Hardware abstraction with AVR, ESP32 counter and host backends
+| 1.1.15  | 2026-10-16 | SV-Zanshin | Added SetStepsPerDetent() and SetRange() in the interrupt
+| 1.1.14  | 2026-10-16 | SV-Zanshin | Added keyframe LED animations played by the timer tick
+| 1.1.13  | 2026-10-16 | SV-Zanshin | Added OnRotate(), OnPush(), OnFadeComplete() and Service()
+| 1.1.12  | 2026-10-16 | SV-Zanshin | Added button gestures: click, double click, long and repeat
+| 1.1.11  | 2026-10-16 | SV-Zanshin | Added optional statistics with GetStats() and ResetStats()
+| 1.1.10  | 2026-10-16 | SV-Zanshin | Added SetPolling(), timer sampling with integrator debounce
+| 1.1.9   | 2026-10-16 | SV-Zanshin | Added EncoderScanner for several encoders on one port
+| 1.1.8   | 2026-10-16 | SV-Zanshin | Added the RotaryEncoder template with compile-time pins
+| 1.1.7   | 2026-10-16 | SV-Zanshin | LED values written to the PWM registers only when changed
+| 1.1.6   | 2026-10-16 | SV-Zanshin | Timer interrupts only run while fading, added Sleep()
+| 1.1.5   | 2026-10-16 | SV-Zanshin | Fixed-point fade engine with SetFadeTime() and gamma table
+| 1.1.4   | 2026-10-16 | SV-Zanshin | Added host simulation layer for native builds and testing
+| 1.1.3   | 2026-10-16 | SV-Zanshin | Added velocity estimate and configurable acceleration
+| 1.1.2   | 2026-10-16 | SV-Zanshin | Atomic 32-bit value, delta and snapshot accessors
+| 1.1.1   | 2026-10-16 | SV-Zanshin | Added event ring buffer with PopEvent() and PopEvents()
+| 1.1.0   | 2026-10-16 | SV-Zanshin | Multiple concurrent instances with per-instance ISRs
+| 1.0.7   | 2026-10-16 | SV-Zanshin | Table-driven quadrature decoding using direct port reads
 | 1.0.4   | 2017-10-03 | SV-Zanshin | Added optional hardware debounce switch on instantiation
 | 1.0.3   | 2016-12-21 | SV-Zanshin | Corrected volatile variables and fixed SetColor() call
 | 1.0.2   | 2016-12-18 | SV-Zanshin | Changed SetFade() to SetFadeRate() to alter fade speed
@@ -91,9 +245,127 @@ Written by Arnd <Arnd@Zanduino.Com> at https://www.github.com/SV-Zanshin
 | 1.0.b1  | 2016-12-04 | SV-Zanshin | Initial coding
 
 */
-#include "Arduino.h"       // Arduino data type definitions
 #ifndef RotaryEncoder_h    // Guard code definition
   #define RotaryEncoder_h  ///< Define the name inside guard code
+  #if defined(ARDUINO)
+    #include "Arduino.h"  // Arduino data type definitions
+  #else
+    #include "RotaryEncoderSim.h"  // Host simulation of the Arduino functions
+  #endif
+  #include "RotaryEncoderHAL.h"  // Processor specific timer, PWM and counter functions
+  #ifndef ROTARY_MAX_ENCODERS
+    #define ROTARY_MAX_ENCODERS 4  ///< Number of encoder instances which can be active at once
+  #endif
+  #ifndef ROTARY_EVENT_BUFFER_SIZE
+    #define ROTARY_EVENT_BUFFER_SIZE 16  ///< Events buffered per instance, must be a power of 2
+  #endif
+  #ifndef ROTARY_ACCEL_ENTRIES
+    #define ROTARY_ACCEL_ENTRIES 4  ///< Maximum number of entries in an acceleration curve
+  #endif
+  #ifndef ROTARY_ENCODER_STATS
+    #define ROTARY_ENCODER_STATS 0  ///< Set to 1 to keep the statistics read by GetStats()
+  #endif
+  #ifndef ROTARY_MAX_SCANNERS
+    #define ROTARY_MAX_SCANNERS 2  ///< Number of EncoderScanner instances which can run at once
+  #endif
+static_assert((ROTARY_EVENT_BUFFER_SIZE & (ROTARY_EVENT_BUFFER_SIZE - 1)) == 0 &&
+                  ROTARY_EVENT_BUFFER_SIZE <= 128,
+              "ROTARY_EVENT_BUFFER_SIZE must be a power of 2 no larger than 128");
+enum EncoderEventType : uint8_t {
+  /*!
+   * @enum  EncoderEventType
+   * @brief Types of the events recorded in the event buffer
+   */
+  ENCODER_CW     = 1,  ///< One clockwise step
+  ENCODER_CCW    = 2,  ///< One counterclockwise step
+  ENCODER_PUSH   = 3,  ///< Pushbutton pressed
+  ENCODER_CLICK  = 4,  ///< Gesture: single click
+  ENCODER_DOUBLE = 5,  ///< Gesture: double click
+  ENCODER_LONG   = 6,  ///< Gesture: button held for the long press time
+  ENCODER_REPEAT = 7   ///< Gesture: repeat while still held after a long press
+};                     // of enumerated type EncoderEventType
+struct EncoderEvent {
+  /*!
+   * @struct EncoderEvent
+   * @brief  Compact timestamped record of a single rotate or pushbutton event
+   */
+  uint16_t time;  ///< Lower 16 bits of millis() when the event occurred
+  uint8_t  type;  ///< One of the EncoderEventType values
+};                // of structure EncoderEvent
+struct EncoderSnapshot {
+  /*!
+   * @struct EncoderSnapshot
+   * @brief  Consistent copy of the encoder state taken with interrupts disabled
+   */
+  int32_t position;   ///< Encoder value
+  uint8_t presses;    ///< Button pushes not yet read with GetButton()
+  int8_t  direction;  ///< Direction of the last step, 1 for clockwise, -1 for counterclockwise
+};                    // of structure EncoderSnapshot
+struct EncoderAccel {
+  /*!
+   * @struct EncoderAccel
+   * @brief  One entry of an acceleration curve
+   */
+  uint16_t interval;    ///< Step interval in microseconds below which the multiplier applies
+  uint8_t  multiplier;  ///< Number of counts per step when turning at least this fast
+};                      // of structure EncoderAccel
+struct EncoderStats {
+  /*!
+   * @struct EncoderStats
+   * @brief  Health counters of one encoder, only kept when ROTARY_ENCODER_STATS is set to 1
+   */
+  uint32_t steps;       ///< Valid quadrature steps
+  uint16_t illegal;     ///< Transitions where both pins changed, so at least one step was missed
+  uint16_t bounces;     ///< Button pushes ignored because they were inside the lockout time
+  uint32_t fadeTicks;   ///< Timer ticks in which a fade step was made
+  uint16_t overflows;   ///< Events dropped because the event buffer was full
+  uint16_t wraps;       ///< Times the 32-bit value wrapped around, SetRange() wraps not included
+  uint16_t peakCycles;  ///< Longest handler run time in CPU cycles, see EncoderHAL::CyclesSince()
+};                      // of structure EncoderStats
+struct EncoderKeyframe {
+  /*!
+   * @struct EncoderKeyframe
+   * @brief  One step of an LED animation in program memory, built with the ROTARY_KEYFRAME,
+   *         ROTARY_LOOP and ROTARY_END macros
+   */
+  uint16_t ticks;  ///< Fade length in 1/2ms timer ticks, or a ROTARY_KEYFRAME_LOOP/END marker
+  uint32_t recip;  ///< 24-bit reciprocal of the fade length, computed at compile time
+  uint8_t  red;    ///< Red level to fade to, or the keyframe to loop back to
+  uint8_t  green;  ///< Green level to fade to, or the number of repeats of a loop (0=forever)
+  uint8_t  blue;   ///< Blue level to fade to
+};                 // of structure EncoderKeyframe
+  #define ROTARY_KEYFRAME_LOOP 0xFFFF  ///< EncoderKeyframe ticks value of a loop keyframe
+  #define ROTARY_KEYFRAME_END  0xFFFE  ///< EncoderKeyframe ticks value of the end keyframe
+  #define ROTARY_KEYFRAME_MAX  32766   ///< Longest keyframe in milliseconds
+  #define ROTARY_KEYFRAME(R, G, B, Millis)                                                   \
+    {(uint16_t)((Millis)*2 + 0 * sizeof(char[(Millis) <= ROTARY_KEYFRAME_MAX ? 1 : -1])), \
+     0xFFFFFFUL / ((Millis) ? (uint32_t)(Millis)*2 : 1), (uint8_t)(R), (uint8_t)(G),     \
+     (uint8_t)(B)}  ///< Fade to a color in 0 to ROTARY_KEYFRAME_MAX milliseconds
+  #define ROTARY_LOOP(Frame, Repeats) \
+    {ROTARY_KEYFRAME_LOOP, 0, (uint8_t)(Frame), (uint8_t)(Repeats), 0}  ///< Loop back to a keyframe
+  #define ROTARY_END {ROTARY_KEYFRAME_END, 0, 0, 0, 0}  ///< End of the animation
+class EncoderClass;  // Forward declaration for the handler types
+typedef void (*EncoderRotateHandler)(EncoderClass& Encoder, const int32_t Delta);  ///< OnRotate()
+typedef void (*EncoderPushHandler)(EncoderClass& Encoder, const uint8_t Presses);  ///< OnPush()
+typedef void (*EncoderFadeHandler)(EncoderClass& Encoder);  ///< OnFadeComplete()
+  #if defined(PCINT2_vect)
+    #define ROTARY_ENCODER_PCINT_VECTORS                 \
+      ISR(PCINT0_vect) { EncoderClass::PinChangeISR(); } \
+      ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));        \
+      ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));        \
+      static const bool rotaryEncoderPCINT = EncoderClass::UsePinChangeWake();  ///< Sleep() wake
+  #elif defined(PCINT1_vect)
+    #define ROTARY_ENCODER_PCINT_VECTORS                 \
+      ISR(PCINT0_vect) { EncoderClass::PinChangeISR(); } \
+      ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));        \
+      static const bool rotaryEncoderPCINT = EncoderClass::UsePinChangeWake();  ///< Sleep() wake
+  #elif defined(PCINT0_vect)
+    #define ROTARY_ENCODER_PCINT_VECTORS                 \
+      ISR(PCINT0_vect) { EncoderClass::PinChangeISR(); } \
+      static const bool rotaryEncoderPCINT = EncoderClass::UsePinChangeWake();  ///< Sleep() wake
+  #else
+    #define ROTARY_ENCODER_PCINT_VECTORS  ///< No pin change interrupts, Sleep() uses idle mode
+  #endif
 class EncoderClass {
   /*!
    * @class EncoderClass
@@ -104,52 +376,237 @@ class EncoderClass {
                const uint8_t PushbuttonPin, const uint8_t RedPin = 255,
                const uint8_t GreenPin = 255, const uint8_t BluePin = 255,
                const bool HWDebounce = false);
-  volatile bool changed = false;                              ///< Set to true on push or rotate
-  uint8_t       GetButton();                                  // Returns number of button pushes
-  int16_t       GetEncoderValue();                            // Return the encoder value
-  static void   TimerISR();                                   // Interim ISR calls real handler
-  void          SetEncoderValue(const int16_t NewValue = 0);  // Set the encoder value
-  void          SetLEDState(const bool Status);               // Turns encoder LEDs on or off
-  void          SetFadeRate(uint8_t FadeSpeed);               // Sets the fader state and speed
-  void          SetColor(const uint8_t R, const uint8_t G, const uint8_t B);  // Sets the LED colors
-  void          SetPushButtonColor(const uint8_t R, const uint8_t G,  // Sets the RGB pushbutton
-                                   const uint8_t B);
-  void          SetCWTurnColor(const uint8_t R, const uint8_t G,   // Sets the RGB values displayed
-                               const uint8_t B);                   // when rotated clockwise
-  void          SetCCWTurnColor(const uint8_t R, const uint8_t G,  // Sets the RGB values displayed
-                                const uint8_t B);                  // when rotated counterclockwise
+  ~EncoderClass();                                                // Class destructor
+  volatile bool   changed = false;                                ///< Set true on push or rotate
+  uint8_t         GetButton();                                    // Returns number of button pushes
+  int16_t         GetEncoderValue();                              // Return the encoder value
+  int32_t         GetEncoderValue32();                            // Return the full encoder value
+  int32_t         GetAndResetDelta();                             // Change since the last call
+  EncoderSnapshot Snapshot();                                     // Position, presses and direction
+  void            OnRotate(EncoderRotateHandler Handler);         // Handler for the net rotation
+  void            OnPush(EncoderPushHandler Handler);             // Handler for button presses
+  void            OnFadeComplete(EncoderFadeHandler Handler);     // Handler for the end of a fade
+  bool            Service();                                      // Call the pending handlers
+  int16_t         GetVelocity();                                  // Signed steps per second
+  void            SetAcceleration(const bool Status);             // Default acceleration on/off
+  void            SetAcceleration(const EncoderAccel* Curve, uint8_t Entries);  // Custom curve
+  bool            PopEvent(EncoderEvent& Event);                  // Get the oldest buffered event
+  uint8_t         PopEvents(EncoderEvent* Buffer, const uint8_t Size);  // Get several events
+  uint16_t        GetEventOverflows();                            // Events lost to a full buffer
+  EncoderStats    GetStats();                                     // Copy of the health counters
+  void            SetGestures(const bool Status);                 // Button gestures on or off
+  void            SetGestureTimes(const uint16_t LongMillis, const uint16_t DoubleMillis,
+                                  const uint16_t RepeatMillis);  // Gesture thresholds
+  void            ResetStats();                                   // Reset the health counters
+  static void     TimerISR();                                     // Services all instance timers
+  static void     PinChangeISR();                                 // Pin change wake-up handler
+  static bool     UsePinChangeWake();                             // Set by the PCINT vector macro
+  static void     Sleep();                                        // Sleep until the next interrupt
+  void            SetEncoderValue(const int32_t NewValue = 0);    // Set the encoder value
+  void            SetStepsPerDetent(const uint8_t Steps);         // x4, x2 or x1 resolution
+  void            SetRange(const int32_t Min, const int32_t Max,  // Clamp or wrap the value
+                           const bool Wrap = false);
+  void            SetPolling(const bool Status, const uint8_t Samples = 3);  // Timer sampling
+  void            SetLEDState(const bool Status);                 // Turns encoder LEDs on or off
+  void            SetFadeRate(uint8_t FadeSpeed);                 // Sets the fader state and speed
+  void            SetFadeTime(const uint16_t Millis);             // Sets the fade time in ms
+  void            SetGamma(const bool Status);                    // Gamma corrected LED values
+  void            SetAnimation(const uint8_t Type, const EncoderKeyframe* Program);  // On event
+  void            PlayAnimation(const EncoderKeyframe* Program);  // Start an animation now
+  void            StopAnimation();                                // Stop the animation
+  void            SetColor(const uint8_t R, const uint8_t G, const uint8_t B);  // Sets LED colors
+  void            SetPushButtonColor(const uint8_t R, const uint8_t G,  // Sets the RGB pushbutton
+                                     const uint8_t B);
+  void            SetCWTurnColor(const uint8_t R, const uint8_t G,   // Sets the RGB values shown
+                                 const uint8_t B);                   // when rotated clockwise
+  void            SetCCWTurnColor(const uint8_t R, const uint8_t G,  // Sets the RGB values shown
+                                  const uint8_t B);                  // when turned counterclockwise
+  friend class EncoderScanner;                                     // Shares the interrupt handlers
+  friend class EncoderStore;                                       // Saves the colors
+ protected:                                                        // Used by RotaryEncoder template
+  typedef void (*LEDWriter)(EncoderClass& Encoder, const uint8_t R, const uint8_t G,
+                            const uint8_t B);  ///< Writes the PWM values of the LEDs which exist
+  EncoderClass(const uint8_t LeftPin, const uint8_t RightPin, const uint8_t PushbuttonPin,
+               const uint8_t RedPin, const uint8_t GreenPin, const uint8_t BluePin,
+               const bool HWDebounce, const bool Attach,
+               const LEDWriter Writer);  // Constructor, optional interrupts and LED writer
+  template <bool Red, bool Green, bool Blue>
+  static void WriteLEDs(EncoderClass& Encoder, const uint8_t R, const uint8_t G,
+                        const uint8_t B);  // Write the LEDs given as template parameters
+  void                  RotateHandler();                  // Real handler for left/right turns
+  void                  RotateStep(const uint8_t encoded);  // Decode a new pin state
+  void                  CounterHandler();                 // Read the hardware counter
+  void                  MoveValue(const int8_t direction);  // Count one step
+  void                  PushButtonHandler();              // Real handler for pushbutton event
+  void                  AttachPins();                     // Attach the pin interrupts
+  void                  DetachPins();                     // Detach the pin interrupts
+  uint8_t               _Slot{ROTARY_MAX_ENCODERS};       ///< Registry slot, MAX if not registered
+  void                  (*_RotateISR)(){nullptr};         ///< Trampoline for the encoder pins
+  void                  (*_PushISR)(){nullptr};           ///< Trampoline for the pushbutton pin
  private:                                                          // Declare private class members
-  static void          PushButtonISR();                            // Interim ISR calls real handler
-  static void          RotateISR();                                // Interim ISR calls real handler
-  void                 RotateHandler();      // Real handler for left/right turns
-  void                 PushButtonHandler();  // Real handler for pushbutton event
-  void                 TimerHandler();       // Called every millisecond for fade
-  static EncoderClass* ClassPtr;             // store pointer to class itself
-  uint8_t              _LeftPin;             ///< Store local copies of the pins
-  uint8_t              _RightPin;            ///< declared at class instantiation
-  uint8_t              _PushbuttonPin;
-  uint8_t              _RedPin;
-  uint8_t              _GreenPin;
-  uint8_t              _BluePin;
-  uint8_t              _FadeMillis{1};        ///< 1=fast, 0=Off
-  bool                 _LEDOn{true};          ///< Default to display LED lights
-  volatile bool        _LEDChanged{true};     ///< Set when rotate or click changes
-  volatile uint8_t     _ButtonPresses{0};     ///< The current number of pushes
-  volatile long        _EncoderValue{0};      ///< The current encoder value
-  volatile uint8_t     _RedActual{255};       ///< Actual value for the Red LED
-  volatile uint8_t     _RedTarget{255};       ///< Target value for the Red LED
-  volatile uint8_t     _GreenActual{255};     ///< Actual value for the Green LED
-  volatile uint8_t     _GreenTarget{255};     ///< Target value for the Green LED
-  volatile uint8_t     _BlueActual{255};      ///< Actual value for the Blue LED
-  volatile uint8_t     _BlueTarget{255};      ///< Target value for the Blue LED
-  uint8_t              _ColorPushButtonR{0};  ///< Default pushbutton to pure Red
-  uint8_t              _ColorPushButtonG{255};
-  uint8_t              _ColorPushButtonB{255};
-  uint8_t              _ColorCWR{255};  ///< Color for clockwise turns
-  uint8_t              _ColorCWG{0};
-  uint8_t              _ColorCWB{255};
-  uint8_t              _ColorCCWR{255};  // Color for counterclockwise turns
-  uint8_t              _ColorCCWG{255};
-  uint8_t              _ColorCCWB{0};
+  template <uint8_t Slot>
+  static void PushButtonISR();  // Interim ISR calls real handler
+  template <uint8_t Slot>
+  static void RotateISR();  // Interim ISR calls real handler
+  template <uint8_t Slot>
+  static void           AttachISRs(const uint8_t slot);   // Attach the trampolines for a slot
+  static void           ArmTimer();                       // Turn on the fade interrupts
+  static void           StartCounters();                  // Set up the waiting hardware counters
+  #if defined(ROTARY_HAL_ESP32)
+  static void           FlushLEDs();                      // Write the queued LED values
+  #endif
+  static bool           SetPinChangeMasks(const bool Enable);  // Pin change interrupts on/off
+  void                  PollHandler();                    // Sample and debounce in polling mode
+  #if ROTARY_ENCODER_STATS
+  static uint32_t       StatsClock();                     // Cycle clock for the statistics
+  void                  StatsTime(const uint32_t Start);  // Record the peak handler run time
+  #endif
+  void                  ButtonEdge(const bool Pressed);   // Pushbutton pressed or released
+  bool                  GestureHandler();                 // Button gestures on the timer tick
+  void                  GestureEvent(const uint8_t Type);  // Report a gesture
+  bool                  TimerHandler();                   // Called every millisecond for fade
+  void                  PushEvent(const uint8_t Type);    // Add an event to the event buffer
+  uint8_t               UpdateVelocity(const int8_t Direction);  // Time a step, get multiplier
+  void                  StartFade();                      // Start fading towards the targets
+  void                  EventColor(const uint8_t R, const uint8_t G, const uint8_t B);  // Show
+  void                  StartAnimation(const EncoderKeyframe* Program);  // Play from the start
+  bool                  AnimationStep();                  // Advance the animation one tick
+  void                  WritePWM(const uint8_t R, const uint8_t G, const uint8_t B);  // LED output
+  void                  WriteChannel(const uint8_t Pin, volatile uint8_t* Register, const bool Wide,
+                                     uint8_t& Shown, const uint8_t Value);  // Write one LED
+  int16_t               FadeStep(const uint16_t Actual, const uint8_t Target,  // Step per tick
+                                 const uint32_t Recip);
+  void                  ShowColor(const uint8_t R, const uint8_t G, const uint8_t B);  // Output
+  void                  SetFadeTicks(uint16_t Ticks);     // Set the fade length in timer ticks
+  static EncoderClass*  _Instances[ROTARY_MAX_ENCODERS];  ///< Registry of active instances
+  static bool           _PinChangeWake;                   ///< Set when the PCINT vectors exist
+  static volatile bool  _PoweredDown;                     ///< Set while in power-down sleep
+  static volatile bool  _CountersPending;                 ///< Set while a counter isn't set up
+  static const LEDWriter _LEDWriters[8];                  ///< WriteLEDs() for each set of LEDs
+  uint8_t               _LeftPin;                         ///< Store local copies of the pins
+  uint8_t               _RightPin;                        ///< declared at class instantiation
+  uint8_t               _PushbuttonPin;
+  uint8_t               _RedPin;
+  uint8_t               _GreenPin;
+  uint8_t               _BluePin;
+  EncoderPort*          _LeftPort;              ///< PINx register for the left pin
+  EncoderPort*          _RightPort;             ///< PINx register for the right pin
+  EncoderMask           _LeftMask;              ///< Bit mask of the left pin in its PINx register
+  EncoderMask           _RightMask;             ///< Bit mask of the right pin in its PINx register
+  EncoderPort*          _ButtonPort;            ///< PINx register for the pushbutton pin
+  EncoderMask           _ButtonMask;            ///< Bit mask of the pushbutton pin
+  uint8_t               _Counter{ROTARY_NO_COUNTER};  ///< Hardware counter unit, if any
+  bool                  _CounterPending{false};  ///< Set until the tick has tried to get a counter
+  bool                  _CounterPullups{false};  ///< Internal pull-ups for the counter pins
+  bool                  _Polling{false};        ///< Set when the pins are sampled by the timer
+  bool                  _PollButton{false};     ///< Set if the pushbutton pin has no interrupt
+  uint8_t               _PollSamples{3};        ///< Integrator limit for the polling debounce
+  uint8_t               _PollCount[3];          ///< Integrators for the right, left, button pins
+  uint8_t               _PollState{0};          ///< Debounced right, left and button levels
+  bool                  _Gestures{false};       ///< Set when gestures are recognized
+  uint8_t               _Gesture{0};            ///< State of the gesture recognizer
+  bool                  _GestureRaw{false};     ///< Last sampled button level
+  bool                  _GesturePressed{false};  ///< Debounced button level
+  uint16_t              _GestureEdge{0};        ///< millis() of the last sampled level change
+  uint16_t              _GestureTime{0};        ///< millis() when the current state was entered
+  uint16_t              _LongMillis{600};       ///< Long press time, 0 for none
+  uint16_t              _DoubleMillis{300};     ///< Double click time, 0 for none
+  uint16_t              _RepeatMillis{200};     ///< Repeat time while held, 0 for none
+  #if ROTARY_ENCODER_STATS
+  EncoderStats          _Stats{0, 0, 0, 0, 0, 0, 0};  ///< Health counters, written by the ISRs
+  #endif
+  uint8_t               _LastEncoded{0};        ///< Last 2-bit quadrature pin state
+  uint32_t              _LastPushed{0};         ///< millis() value of last accepted button push
+  uint32_t              _LastReleased{0};       ///< millis() value of the last button release
+  volatile EncoderEvent _Events[ROTARY_EVENT_BUFFER_SIZE];  ///< Event ring buffer
+  volatile uint8_t      _EventHead{0};          ///< Free running write index, only set by ISRs
+  volatile uint8_t      _EventTail{0};          ///< Free running read index, only set by PopEvent()
+  volatile uint16_t     _EventOverflows{0};     ///< Number of events dropped on a full buffer
+  uint16_t              _FadeTicks{255};        ///< Timer ticks per fade, 0=Off
+  uint32_t              _FadeRecip{0xFFFFFF / 255};  ///< 24-bit reciprocal of _FadeTicks
+  volatile uint16_t     _FadeTicksLeft{0};      ///< Ticks until the current fade is complete
+  bool                  _Gamma{false};          ///< Set when gamma correction is on
+  bool                  _LEDOn{true};           ///< Default to display LED lights
+  volatile bool         _LEDChanged{true};      ///< Set when rotate or click changes
+  volatile uint8_t      _ButtonPresses{0};      ///< The current number of pushes
+  volatile int32_t      _EncoderValue{0};       ///< The current encoder value
+  volatile int8_t       _Direction{0};          ///< Direction of the last step
+  int32_t               _DeltaBase{0};          ///< Value at the last GetAndResetDelta() call
+  uint8_t               _StepsPerDetent{1};     ///< Transitions per counted step, 1, 2 or 4
+  uint8_t               _DetentState{0};        ///< Pin state at a detent
+  int8_t                _DetentSteps{0};        ///< Transitions since the last detent
+  bool                  _Range{false};          ///< Set when the value is kept within a range
+  bool                  _RangeWrap{false};      ///< Wrap around instead of stopping at the limits
+  int32_t               _RangeMin{0};           ///< Lowest value of the range
+  int32_t               _RangeMax{0};           ///< Highest value of the range
+  const EncoderKeyframe* _Animations[ENCODER_REPEAT]{};  ///< Animation of each event type
+  const EncoderKeyframe* volatile _Program{nullptr};    ///< Playing animation, nullptr if none
+  uint8_t               _Frame{0};              ///< Index of the next keyframe to load
+  uint8_t               _LoopsLeft{0};          ///< Repeats left of the counted loop, 0 if none
+  EncoderRotateHandler  _OnRotate{nullptr};     ///< Called by Service() with the net rotation
+  EncoderPushHandler    _OnPush{nullptr};       ///< Called by Service() with the presses
+  EncoderFadeHandler    _OnFade{nullptr};       ///< Called by Service() when a fade is complete
+  volatile int32_t      _PendingDelta{0};       ///< Net rotation not yet passed to _OnRotate
+  volatile uint8_t      _PendingPushes{0};      ///< Presses not yet passed to _OnPush
+  volatile bool         _PendingFade{false};    ///< Set when a fade completed for _OnFade
+  volatile uint32_t     _LastStepMicros{0};     ///< micros() value of the last valid step
+  volatile uint16_t     _StepInterval{0xFFFF};  ///< Smoothed step interval in 4us units
+  EncoderAccel          _Accel[ROTARY_ACCEL_ENTRIES];  ///< Acceleration curve in 4us units
+  volatile uint8_t      _AccelEntries{0};       ///< Entries in use, 0 turns acceleration off
+  volatile uint16_t     _RedActual{0xFF00};     ///< Actual 8.8 value for the Red LED
+  volatile uint8_t      _RedTarget{255};        ///< Target value for the Red LED
+  volatile uint16_t     _GreenActual{0xFF00};   ///< Actual 8.8 value for the Green LED
+  volatile uint8_t      _GreenTarget{255};      ///< Target value for the Green LED
+  volatile uint16_t     _BlueActual{0xFF00};    ///< Actual 8.8 value for the Blue LED
+  volatile uint8_t      _BlueTarget{255};       ///< Target value for the Blue LED
+  int16_t               _RedStep{0};            ///< 8.8 Red change per tick
+  int16_t               _GreenStep{0};          ///< 8.8 Green change per tick
+  int16_t               _BlueStep{0};           ///< 8.8 Blue change per tick
+  #if defined(ROTARY_HAL_ESP32)
+  volatile bool         _LEDsQueued{false};     ///< Set when _LEDQueue waits for FlushLEDs()
+  uint8_t               _LEDQueue[3];           ///< Red, Green and Blue values to write
+  #endif
+  volatile uint8_t*     _RedOCR{nullptr};       ///< PWM compare register of the Red LED
+  volatile uint8_t*     _GreenOCR{nullptr};     ///< PWM compare register of the Green LED
+  volatile uint8_t*     _BlueOCR{nullptr};      ///< PWM compare register of the Blue LED
+  uint8_t               _WideOCR{0};            ///< Bits 0-2 set for 16-bit R, G, B registers
+  LEDWriter             _WriteLEDs;             ///< WriteLEDs() for the LED pins which exist
+  uint8_t               _RedShown{0};           ///< PWM value last written to the Red LED
+  uint8_t               _GreenShown{0};         ///< PWM value last written to the Green LED
+  uint8_t               _BlueShown{0};          ///< PWM value last written to the Blue LED
+  uint8_t               _ColorPushButtonR{0};   ///< Default pushbutton to pure Red
+  uint8_t               _ColorPushButtonG{255};
+  uint8_t               _ColorPushButtonB{255};
+  uint8_t               _ColorCWR{255};  ///< Color for clockwise turns
+  uint8_t               _ColorCWG{0};
+  uint8_t               _ColorCWB{255};
+  uint8_t               _ColorCCWR{255};  // Color for counterclockwise turns
+  uint8_t               _ColorCCWG{255};
+  uint8_t               _ColorCCWB{0};
 };  // of class header definition for EncoderClass
+
+template <bool Red, bool Green, bool Blue>
+void ROTARY_IRAM EncoderClass::WriteLEDs(EncoderClass& Encoder, const uint8_t R, const uint8_t G,
+                                         const uint8_t B) {
+  /*!
+    @brief     Write the PWM values of the LEDs given as template parameters
+    @details   One instance is chosen for each encoder when it is constructed, so whether an LED
+               exists is decided at compile time and not tested on every write
+    @param[in] Encoder Encoder whose LEDs are written
+    @param[in] R       Red PWM value
+    @param[in] G       Green PWM value
+    @param[in] B       Blue PWM value
+  */
+  if (Red) Encoder.WriteChannel(Encoder._RedPin, Encoder._RedOCR, Encoder._WideOCR & 0b001,
+                                Encoder._RedShown, R);
+  if (Green) Encoder.WriteChannel(Encoder._GreenPin, Encoder._GreenOCR, Encoder._WideOCR & 0b010,
+                                  Encoder._GreenShown, G);
+  if (Blue) Encoder.WriteChannel(Encoder._BluePin, Encoder._BlueOCR, Encoder._WideOCR & 0b100,
+                                 Encoder._BlueShown, B);
+}  // of method WriteLEDs()
+  #include "RotaryEncoderTemplate.h"  // Compile-time pin configuration front-end
+  #if defined(ROTARY_HAL_BYTE_PORTS)
+    #include "RotaryEncoderScanner.h"  // Multi-encoder port scanner
+  #endif
+  #include "RotaryEncoderStore.h"  // EEPROM persistence of the value and colors
 #endif
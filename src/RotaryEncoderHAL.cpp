@@ -0,0 +1,687 @@
+/*! @file RotaryEncoderHAL.cpp
+    @section RotaryEncoderHAL_intro_section Description
+
+    Arduino Library for reading a rotary encoder \n\n
+    Processor specific backends, see the hardware abstraction header file for all details
+*/
+#include "RotaryEncoder.h"  // Include the header file
+#if defined(ROTARY_HAL_ESP32)
+  #include <driver/gpio.h>      // Pull-up resistors
+  #include <esp_idf_version.h>  // ESP_IDF_VERSION_MAJOR
+  #include <esp_timer.h>        // High resolution timer
+  #include <freertos/FreeRTOS.h>  // FreeRTOS types
+  #include <freertos/task.h>      // xTaskGetSchedulerState()
+  #include <freertos/timers.h>    // xTimerPendFunctionCallFromISR()
+  #include <soc/soc_caps.h>     // SOC_PCNT_SUPPORTED
+  #if ESP_IDF_VERSION_MAJOR >= 5
+    #include <esp_cpu.h>  // esp_cpu_get_cycle_count()
+  #else
+    #include <hal/cpu_hal.h>  // cpu_hal_get_cycle_count()
+  #endif
+  #if ESP_IDF_VERSION_MAJOR >= 5
+    #if SOC_PCNT_SUPPORTED
+      #include <driver/pulse_cnt.h>                        // Pulse counter driver of ESP-IDF 5
+      #define ROTARY_PCNT                                  ///< The processor has a pulse counter
+      #define ROTARY_PCNT_UNITS SOC_PCNT_UNITS_PER_GROUP  ///< Number of pulse counter units
+    #endif
+  #elif !defined(CONFIG_IDF_TARGET_ESP32C3)
+    #include <driver/pcnt.h>                  // Legacy pulse counter driver of ESP-IDF 4
+    #define ROTARY_PCNT                       ///< The processor has a pulse counter
+    #define ROTARY_PCNT_LEGACY                ///< which is used with the legacy driver
+    #define ROTARY_PCNT_UNITS PCNT_UNIT_MAX  ///< Number of pulse counter units, an enum value
+  #endif
+#endif
+#if defined(ROTARY_HAL_AVR) || defined(ROTARY_HAL_HOST)
+ISR(TIMER0_COMPA_vect) {
+  /*!
+    @brief   Interrupt vector for TIMER0_COMPA
+    @details Indirect call to the TimerISR()
+  */
+  EncoderClass::TimerISR();
+}  // Call the ISR every millisecond
+ISR(TIMER0_COMPB_vect) {
+  /*!
+    @brief   Interrupt vector for TIMER0_COMPB
+    @details Indirect call to the TimerISR()
+  */
+  EncoderClass::TimerISR();
+}  // Call the ISR every millisecond
+void EncoderHAL::TimerStart() {
+  /*!
+    @brief   Turn on the Timer0 compare interrupts
+    @details Timer0 is used by the millis() function and is an 8-bit register with a clock divisor
+             of 64 which triggers it to overflow at a rate of 976.5625Hz, or roughly every
+             millisecond. TIMER0_COMPA_vect is set to trigger when the value is equal to 64 and
+             TIMER0_COMPB_vect when it is equal to 192, giving 2 interrupts per millisecond at
+             different trigger points to the millis() overflow. Must be called with interrupts
+             disabled, as is always the case in the interrupt handlers. On the host the simulated
+             Timer0 of "RotaryEncoderSim.h" is used.
+  */
+  OCR0A = 0x40;                         // Comparison register A to 64
+  OCR0B = 0xC0;                         // Comparison register B to 192
+  TIMSK0 |= _BV(OCIE0A) | _BV(OCIE0B);  // TIMER0_COMPA and TIMER0_COMPB triggers on
+}  // of method TimerStart()
+void EncoderHAL::TimerStop() {
+  /*!
+    @brief   Turn off the Timer0 compare interrupts
+  */
+  TIMSK0 &= ~(_BV(OCIE0A) | _BV(OCIE0B));
+}  // of method TimerStop()
+void EncoderHAL::TimerRetry() {
+  /*!
+    @brief   Send a tick start which couldn't be sent earlier
+    @details Nothing to do, TimerStart() always turns the interrupts on directly
+  */
+}  // of method TimerRetry()
+bool EncoderHAL::TimerRunning() {
+  /*!
+    @brief   Return whether the Timer0 compare interrupts are turned on
+    @return  true while the tick is running
+  */
+  return TIMSK0 & (_BV(OCIE0A) | _BV(OCIE0B));
+}  // of method TimerRunning()
+uint32_t EncoderHAL::CycleCount() {
+  /*!
+    @brief   Return the free running clock used by the statistics
+    @details The AVR processors have no cycle counter, so the free-running Timer0 counter used by
+             millis() is read instead. It counts once every 64 CPU cycles.
+    @return  Timer0 count, 0 if the processor has no Timer0
+  */
+  #if defined(TCNT0)
+  return TCNT0;
+  #else
+  return 0;
+  #endif
+}  // of method CycleCount()
+uint16_t EncoderHAL::CyclesSince(const uint32_t Start) {
+  /*!
+    @brief     Return the CPU cycles since a CycleCount() call
+    @details   The 8-bit Timer0 count wraps after 16384 cycles, so longer times aren't measured
+               correctly, and the result has a resolution of 64 cycles
+    @param[in] Start Value returned by CycleCount()
+    @return    CPU cycles
+  */
+  return (uint16_t)(uint8_t)(CycleCount() - Start) << 6;  // 64 cycles per count
+}  // of method CyclesSince()
+#endif
+#if defined(ROTARY_HAL_AVR)
+volatile uint8_t* EncoderHAL::PWMRegister(const uint8_t Pin, bool& Wide) {
+  /*!
+    @brief      Look up the PWM compare register of a pin
+    @details    Uses the "digitalPinToTimer()" macro of the Arduino core and the same cases as its
+                analogWrite() function. Timers 1, 3 and 5 (and timer 4 when it is a 16-bit timer)
+                have 16-bit compare registers, which must be written as a word so that the high
+                byte is set from the value and not from whatever the shared TEMP register contains.
+    @param[in]  Pin  Arduino pin number
+    @param[out] Wide Set to true if the compare register is 16 bits wide
+    @return     Address of the (low byte of the) compare register, nullptr if the pin has no PWM
+  */
+  Wide = false;
+  switch (digitalPinToTimer(Pin)) {
+  #if defined(TCCR0A) && defined(COM0A1)
+    case TIMER0A: return &OCR0A;
+  #endif
+  #if defined(TCCR0A) && defined(COM0B1)
+    case TIMER0B: return &OCR0B;
+  #endif
+  #if defined(TCCR2) && defined(COM21)
+    case TIMER2: return &OCR2;
+  #endif
+  #if defined(TCCR2A) && defined(COM2A1)
+    case TIMER2A: return &OCR2A;
+  #endif
+  #if defined(TCCR2A) && defined(COM2B1)
+    case TIMER2B: return &OCR2B;
+  #endif
+  #if defined(TCCR4A) && defined(COM4A1) && !defined(OCR4AH)
+    case TIMER4A: return &OCR4A;  // 10-bit high speed timer of the ATmega32U4
+  #endif
+  #if defined(TCCR4A) && defined(COM4B1) && !defined(OCR4BH)
+    case TIMER4B: return &OCR4B;
+  #endif
+  #if defined(TCCR4C) && defined(COM4D1)
+    case TIMER4D: return &OCR4D;
+  #endif
+    default: break;
+  }  // of switch 8-bit timers
+  Wide = true;
+  switch (digitalPinToTimer(Pin)) {
+  #if defined(TCCR1A) && defined(COM1A1)
+    case TIMER1A: return (volatile uint8_t*)&OCR1A;
+  #endif
+  #if defined(TCCR1A) && defined(COM1B1)
+    case TIMER1B: return (volatile uint8_t*)&OCR1B;
+  #endif
+  #if defined(TCCR1A) && defined(COM1C1)
+    case TIMER1C: return (volatile uint8_t*)&OCR1C;
+  #endif
+  #if defined(TCCR3A) && defined(COM3A1)
+    case TIMER3A: return (volatile uint8_t*)&OCR3A;
+  #endif
+  #if defined(TCCR3A) && defined(COM3B1)
+    case TIMER3B: return (volatile uint8_t*)&OCR3B;
+  #endif
+  #if defined(TCCR3A) && defined(COM3C1)
+    case TIMER3C: return (volatile uint8_t*)&OCR3C;
+  #endif
+  #if defined(TCCR4A) && defined(COM4A1) && defined(OCR4AH)
+    case TIMER4A: return (volatile uint8_t*)&OCR4A;  // 16-bit timer 4 of the ATmega2560
+  #endif
+  #if defined(TCCR4A) && defined(COM4B1) && defined(OCR4BH)
+    case TIMER4B: return (volatile uint8_t*)&OCR4B;
+  #endif
+  #if defined(TCCR4A) && defined(COM4C1) && defined(OCR4CH)
+    case TIMER4C: return (volatile uint8_t*)&OCR4C;
+  #endif
+  #if defined(TCCR5A) && defined(COM5A1)
+    case TIMER5A: return (volatile uint8_t*)&OCR5A;
+  #endif
+  #if defined(TCCR5A) && defined(COM5B1)
+    case TIMER5B: return (volatile uint8_t*)&OCR5B;
+  #endif
+  #if defined(TCCR5A) && defined(COM5C1)
+    case TIMER5C: return (volatile uint8_t*)&OCR5C;
+  #endif
+    default: break;
+  }  // of switch 16-bit timers
+  Wide = false;
+  return nullptr;
+}  // of method PWMRegister()
+#else
+volatile uint8_t* EncoderHAL::PWMRegister(const uint8_t Pin, bool& Wide) {
+  /*!
+    @brief      Look up the PWM compare register of a pin
+    @details    Only the AVR backend writes the compare registers directly, all others use
+                analogWrite()
+    @param[in]  Pin  Arduino pin number (unused)
+    @param[out] Wide Set to false
+    @return     nullptr
+  */
+  (void)Pin;
+  Wide = false;
+  return nullptr;
+}  // of method PWMRegister()
+#endif
+#if defined(ROTARY_HAL_ESP32)
+portMUX_TYPE              EncoderHAL::_Lock = portMUX_INITIALIZER_UNLOCKED;  ///< Shared spinlock
+static esp_timer_handle_t timerHandle{nullptr};  ///< Periodic timer of the tick, made on first use
+static volatile bool      tickOn{false};         ///< Set while the tick is wanted
+static volatile bool      tickUnsent{false};     ///< Set when a start couldn't be sent yet
+  #if defined(ROTARY_PCNT)
+static uint8_t counterUnits{0};                 ///< Bit set for each PCNT unit in use
+static int16_t counterLast[ROTARY_PCNT_UNITS];  ///< Count at the last CounterSteps() call
+  #endif
+  #if defined(ROTARY_PCNT) && !defined(ROTARY_PCNT_LEGACY)
+static pcnt_unit_handle_t    counterHandles[ROTARY_PCNT_UNITS];       ///< Unit of each counter
+static pcnt_channel_handle_t counterChannels[ROTARY_PCNT_UNITS][2];  ///< Channels of each counter
+  #endif
+static void TimerCallback(void* Arg) {
+  /*!
+    @brief     Callback of the periodic esp_timer
+    @details   Runs in the esp_timer task. When the tick handler has turned the tick off the
+               esp_timer is stopped here, outside of the critical section, and started again at
+               once if an interrupt wanted the tick back in the meantime.
+    @param[in] Arg Unused
+  */
+  (void)Arg;
+  EncoderClass::TimerISR();
+  bool on;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { on = tickOn; }
+  if (on) return;  // Still needed
+  esp_timer_stop(timerHandle);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { on = tickOn; }
+  if (on) esp_timer_start_periodic(timerHandle, 500);  // Wanted again while stopping
+}  // of function TimerCallback()
+static void StartTick(void* Arg, uint32_t Value) {
+  /*!
+    @brief     Create the esp_timer if needed and start it
+    @details   Runs in the FreeRTOS timer task, where sent by TimerStart(). When the esp_timer
+               can't be created the start is kept for TimerRetry(), so it is tried again later.
+    @param[in] Arg   Unused
+    @param[in] Value Unused
+  */
+  (void)Arg;
+  (void)Value;
+  if (timerHandle == nullptr) {
+    esp_timer_create_args_t args = {};
+    args.callback                = TimerCallback;
+    args.name                    = "RotaryEncoder";
+    if (esp_timer_create(&args, &timerHandle) != ESP_OK) {
+      timerHandle = nullptr;
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        tickOn     = false;  // Try again on the next
+        tickUnsent = true;   // TimerRetry()
+      }                      // of atomic block
+      return;
+    }  // of if-then timer not created
+  }    // of if-then first start
+  bool on;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { on = tickOn; }
+  if (on) esp_timer_start_periodic(timerHandle, 500);  // Every 500 microseconds
+}  // of function StartTick()
+static void ROTARY_IRAM SendStart() {
+  /*!
+    @brief   Send the tick start to the FreeRTOS timer task
+    @details esp_timer can't be started from an interrupt handler or a critical section, so the
+             start is handed to the timer task. Before the scheduler runs, i.e. in the constructors
+             of global instances, nothing can be sent and TimerRetry() sends it later.
+  */
+  tickUnsent = xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED ||
+               xTimerPendFunctionCallFromISR(StartTick, nullptr, 0, nullptr) != pdPASS;
+}  // of function SendStart()
+void ROTARY_IRAM EncoderHAL::TimerStart() {
+  /*!
+    @brief   Start the timer tick
+    @details The esp_timer is created on the first start and not by the constructors, see
+             StartTick(). Must be called with interrupts disabled, as in the AVR backend.
+  */
+  if (tickOn) return;  // Already running
+  tickOn = true;
+  SendStart();
+}  // of method TimerStart()
+void ROTARY_IRAM EncoderHAL::TimerStop() {
+  /*!
+    @brief   Stop the timer tick
+    @details Only marks the tick as idle, the esp_timer itself is stopped by TimerCallback() once
+             the tick handler has returned. Must be called with interrupts disabled.
+  */
+  tickOn = false;
+}  // of method TimerStop()
+void EncoderHAL::TimerRetry() {
+  /*!
+    @brief   Send a tick start which couldn't be sent earlier
+    @details Called from the functions which read the encoder, so that a tick started before the
+             scheduler ran, or whose esp_timer couldn't be created, is started from a task
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (tickUnsent) {
+      tickOn = true;
+      SendStart();
+    }  // of if-then start not sent
+  }    // of atomic block
+}  // of method TimerRetry()
+bool ROTARY_IRAM EncoderHAL::TimerRunning() {
+  /*!
+    @brief   Return whether the timer tick is running
+    @return  true while the tick is wanted, even if the esp_timer hasn't started yet
+  */
+  return tickOn;
+}  // of method TimerRunning()
+uint32_t ROTARY_IRAM EncoderHAL::CycleCount() {
+  /*!
+    @brief   Return the free running clock used by the statistics
+    @details The CPU cycle counter of the core the code runs on
+    @return  CPU cycle count
+  */
+  #if ESP_IDF_VERSION_MAJOR >= 5
+  return (uint32_t)esp_cpu_get_cycle_count();
+  #else
+  return cpu_hal_get_cycle_count();
+  #endif
+}  // of method CycleCount()
+uint16_t ROTARY_IRAM EncoderHAL::CyclesSince(const uint32_t Start) {
+  /*!
+    @brief     Return the CPU cycles since a CycleCount() call
+    @details   Exact to the cycle and limited to 65535, which is 273 microseconds at 240MHz
+    @param[in] Start Value returned by CycleCount()
+    @return    CPU cycles
+  */
+  uint32_t cycles = CycleCount() - Start;
+  return cycles > 0xFFFF ? 0xFFFF : (uint16_t)cycles;
+}  // of method CyclesSince()
+uint8_t EncoderHAL::CounterBegin(const uint8_t LeftPin, const uint8_t RightPin,
+                                 const bool Pullups) {
+  /*!
+    @brief     Set up a free PCNT unit as a quadrature counter
+    @details   Channel 0 counts the edges of the left pin and channel 1 those of the right pin, each
+               using the other pin as the direction control, so that all 4 transitions of a step
+               are counted: up clockwise, i.e. for the 00, 10, 11, 01 sequence, and down the other
+               way. The glitch filter ignores pulses shorter than about 12.5us, 1023 APB clock
+               cycles with the legacy driver. The 16-bit counter is reset to 0 when it reaches
+               +-32767, which CounterSteps() allows for.
+    @param[in] LeftPin  GPIO of the left encoder contact
+    @param[in] RightPin GPIO of the right encoder contact
+    @param[in] Pullups  true to turn on the internal pull-up resistors
+    @return    PCNT unit, ROTARY_NO_COUNTER if no unit is free or the processor has none
+  */
+  #if defined(ROTARY_PCNT)
+  uint8_t unit = 0;
+  while (unit < ROTARY_PCNT_UNITS && (counterUnits & (1 << unit))) unit++;  // Find a free unit
+  if (unit == ROTARY_PCNT_UNITS) return ROTARY_NO_COUNTER;
+    #if defined(ROTARY_PCNT_LEGACY)
+  pcnt_config_t config  = {};
+  config.pulse_gpio_num = LeftPin;  // Channel 0 counts the left pin edges
+  config.ctrl_gpio_num  = RightPin;
+  config.channel        = PCNT_CHANNEL_0;
+  config.unit           = (pcnt_unit_t)unit;
+  config.pos_mode       = PCNT_COUNT_INC;      // Left rises while right is low: clockwise
+  config.neg_mode       = PCNT_COUNT_DEC;      // Left falls while right is low: counterclockwise
+  config.lctrl_mode     = PCNT_MODE_KEEP;      // and the other way round
+  config.hctrl_mode     = PCNT_MODE_REVERSE;   // while the right pin is high
+  config.counter_h_lim  = 32767;
+  config.counter_l_lim  = -32767;
+  if (pcnt_unit_config(&config) != ESP_OK) return ROTARY_NO_COUNTER;
+  config.pulse_gpio_num = RightPin;  // Channel 1 counts the right pin edges
+  config.ctrl_gpio_num  = LeftPin;
+  config.channel        = PCNT_CHANNEL_1;
+  config.pos_mode       = PCNT_COUNT_DEC;  // Right rises while left is low: counterclockwise
+  config.neg_mode       = PCNT_COUNT_INC;  // Right falls while left is low: clockwise
+  if (pcnt_unit_config(&config) != ESP_OK) return ROTARY_NO_COUNTER;
+  pcnt_set_filter_value((pcnt_unit_t)unit, 1023);
+  pcnt_filter_enable((pcnt_unit_t)unit);
+  pcnt_counter_pause((pcnt_unit_t)unit);
+  pcnt_counter_clear((pcnt_unit_t)unit);
+  pcnt_counter_resume((pcnt_unit_t)unit);
+    #else
+  pcnt_unit_config_t unitConfig = {};
+  unitConfig.low_limit          = -32767;
+  unitConfig.high_limit         = 32767;
+  pcnt_unit_handle_t handle     = nullptr;
+  if (pcnt_new_unit(&unitConfig, &handle) != ESP_OK) return ROTARY_NO_COUNTER;
+  pcnt_glitch_filter_config_t filter = {};
+  filter.max_glitch_ns               = 12500;
+  pcnt_unit_set_glitch_filter(handle, &filter);
+  pcnt_chan_config_t channelConfig = {};
+  channelConfig.edge_gpio_num      = LeftPin;  // Channel 0 counts the left pin edges
+  channelConfig.level_gpio_num     = RightPin;
+  pcnt_channel_handle_t left = nullptr, right = nullptr;
+  if (pcnt_new_channel(handle, &channelConfig, &left) != ESP_OK) {
+    pcnt_del_unit(handle);
+    return ROTARY_NO_COUNTER;
+  }                                           // of if-then no channel
+  channelConfig.edge_gpio_num  = RightPin;    // Channel 1 counts the right pin edges
+  channelConfig.level_gpio_num = LeftPin;
+  if (pcnt_new_channel(handle, &channelConfig, &right) != ESP_OK) {
+    pcnt_del_channel(left);
+    pcnt_del_unit(handle);
+    return ROTARY_NO_COUNTER;
+  }  // of if-then no channel
+  pcnt_channel_set_edge_action(left, PCNT_CHANNEL_EDGE_ACTION_INCREASE,   // Left rises while
+                               PCNT_CHANNEL_EDGE_ACTION_DECREASE);        // right is low: CW
+  pcnt_channel_set_level_action(left, PCNT_CHANNEL_LEVEL_ACTION_INVERSE,  // the other way round
+                                PCNT_CHANNEL_LEVEL_ACTION_KEEP);          // while right is high
+  pcnt_channel_set_edge_action(right, PCNT_CHANNEL_EDGE_ACTION_DECREASE,  // Right rises while
+                               PCNT_CHANNEL_EDGE_ACTION_INCREASE);        // left is low: CCW
+  pcnt_channel_set_level_action(right, PCNT_CHANNEL_LEVEL_ACTION_INVERSE,
+                                PCNT_CHANNEL_LEVEL_ACTION_KEEP);
+  pcnt_unit_enable(handle);
+  pcnt_unit_clear_count(handle);
+  pcnt_unit_start(handle);
+  counterHandles[unit]     = handle;
+  counterChannels[unit][0] = left;
+  counterChannels[unit][1] = right;
+    #endif
+  if (Pullups) {                              // The drivers don't agree on the pull-ups,
+    gpio_pullup_en((gpio_num_t)LeftPin);      // so set them explicitly, on for the
+    gpio_pullup_en((gpio_num_t)RightPin);     // internal pull-up resistors
+  } else {                                    // and off for external ones
+    gpio_pullup_dis((gpio_num_t)LeftPin);
+    gpio_pullup_dis((gpio_num_t)RightPin);
+  }  // of if-then-else pull-ups
+  counterUnits |= 1 << unit;
+  counterLast[unit] = 0;
+  return unit;
+  #else
+  (void)LeftPin;
+  (void)RightPin;
+  (void)Pullups;
+  return ROTARY_NO_COUNTER;
+  #endif
+}  // of method CounterBegin()
+int16_t ROTARY_IRAM EncoderHAL::CounterSteps(const uint8_t Unit) {
+  /*!
+    @brief     Return the transitions counted since the last call
+    @details   One read of the count register. The counter runs freely and is reset to 0 at
+               +-32767, so a difference of more than half of that range is a reset and is corrected,
+               which is safe since far fewer than 16383 transitions happen between two ticks.
+    @param[in] Unit PCNT unit returned by CounterBegin()
+    @return    Signed number of transitions, positive for clockwise
+  */
+  #if defined(ROTARY_PCNT)
+    #if defined(ROTARY_PCNT_LEGACY)
+  int16_t count;
+  pcnt_get_counter_value((pcnt_unit_t)Unit, &count);
+    #else
+  int count;
+  pcnt_unit_get_count(counterHandles[Unit], &count);
+    #endif
+  int32_t steps     = (int32_t)count - counterLast[Unit];
+  counterLast[Unit] = count;
+  if (steps > 16383)  // The counter was reset at the upper limit
+    steps -= 32767;
+  else if (steps < -16383)  // or at the lower limit
+    steps += 32767;
+  return (int16_t)steps;
+  #else
+  (void)Unit;
+  return 0;
+  #endif
+}  // of method CounterSteps()
+void EncoderHAL::CounterEnd(const uint8_t Unit) {
+  /*!
+    @brief     Stop and free a PCNT unit
+    @param[in] Unit PCNT unit returned by CounterBegin()
+  */
+  #if defined(ROTARY_PCNT)
+  if (Unit >= ROTARY_PCNT_UNITS) return;
+    #if defined(ROTARY_PCNT_LEGACY)
+  pcnt_counter_pause((pcnt_unit_t)Unit);
+    #else
+  pcnt_unit_stop(counterHandles[Unit]);
+  pcnt_unit_disable(counterHandles[Unit]);
+  pcnt_del_channel(counterChannels[Unit][0]);
+  pcnt_del_channel(counterChannels[Unit][1]);
+  pcnt_del_unit(counterHandles[Unit]);
+    #endif
+  counterUnits &= ~(1 << Unit);
+  #else
+  (void)Unit;
+  #endif
+}  // of method CounterEnd()
+#elif defined(ROTARY_HAL_COUNTER)
+static int16_t counterLast[SIM_COUNTERS];  ///< Count at the last CounterSteps() call
+uint8_t        EncoderHAL::CounterBegin(const uint8_t LeftPin, const uint8_t RightPin,
+                                        const bool Pullups) {
+  /*!
+    @brief     Attach the pins to a simulated quadrature counter
+    @param[in] LeftPin  Simulated pin of the left encoder contact
+    @param[in] RightPin Simulated pin of the right encoder contact
+    @param[in] Pullups  Unused, pull-ups aren't simulated
+    @return    Counter unit, ROTARY_NO_COUNTER if no counter is free
+  */
+  (void)Pullups;
+  uint8_t unit = EncoderSimulator::AttachCounter(LeftPin, RightPin);
+  if (unit == 255) return ROTARY_NO_COUNTER;
+  counterLast[unit] = 0;
+  return unit;
+}  // of method CounterBegin()
+int16_t EncoderHAL::CounterSteps(const uint8_t Unit) {
+  /*!
+    @brief     Return the transitions counted since the last call
+    @param[in] Unit Counter unit returned by CounterBegin()
+    @return    Signed number of transitions, positive for clockwise
+  */
+  int16_t count      = EncoderSimulator::Counters[Unit];
+  int16_t steps      = count - counterLast[Unit];  // The 16-bit difference allows for overflows
+  counterLast[Unit] = count;
+  return steps;
+}  // of method CounterSteps()
+void EncoderHAL::CounterEnd(const uint8_t Unit) {
+  /*!
+    @brief     Free a simulated quadrature counter
+    @param[in] Unit Counter unit returned by CounterBegin()
+  */
+  EncoderSimulator::DetachCounter(Unit);
+}  // of method CounterEnd()
+#else
+uint8_t EncoderHAL::CounterBegin(const uint8_t LeftPin, const uint8_t RightPin,
+                                 const bool Pullups) {
+  /*!
+    @brief     Set up a hardware quadrature counter
+    @details   This backend has no counter, so the encoder pins are decoded in the pin interrupts
+    @param[in] LeftPin  Pin of the left encoder contact (unused)
+    @param[in] RightPin Pin of the right encoder contact (unused)
+    @param[in] Pullups  true to turn on the pull-up resistors (unused)
+    @return    ROTARY_NO_COUNTER
+  */
+  (void)LeftPin;
+  (void)RightPin;
+  (void)Pullups;
+  return ROTARY_NO_COUNTER;
+}  // of method CounterBegin()
+int16_t EncoderHAL::CounterSteps(const uint8_t Unit) {
+  /*!
+    @brief     Return the transitions counted since the last call
+    @param[in] Unit Counter unit (unused)
+    @return    0, there is no counter
+  */
+  (void)Unit;
+  return 0;
+}  // of method CounterSteps()
+void EncoderHAL::CounterEnd(const uint8_t Unit) {
+  /*!
+    @brief     Stop and free a counter
+    @param[in] Unit Counter unit (unused)
+  */
+  (void)Unit;
+}  // of method CounterEnd()
+#endif
+#if defined(ROTARY_HAL_AVR) && defined(EECR)
+  #if !defined(EEPE) && defined(EEWE)
+    #define EEPE  EEWE   ///< Older processors call the write enable bit EEWE
+    #define EEMPE EEMWE  ///< and the master write enable bit EEMWE
+  #endif
+uint16_t EncoderHAL::EepromSize() {
+  /*!
+    @brief   Return the size of the EEPROM
+    @return  Number of bytes
+  */
+  return E2END + 1;
+}  // of method EepromSize()
+uint8_t EncoderHAL::EepromRead(const uint16_t Address) {
+  /*!
+    @brief     Read a byte of the EEPROM
+    @details   Waits for a running write to finish first, as the EEPROM can't be read until then
+    @param[in] Address EEPROM address
+    @return    Value of the byte
+  */
+  while (EECR & _BV(EEPE)) {}  // Wait for the previous write
+  EEAR = Address;
+  EECR |= _BV(EERE);           // Read, the value is available at once
+  return EEDR;
+}  // of method EepromRead()
+bool EncoderHAL::EepromReady() {
+  /*!
+    @brief   Return whether a byte can be written
+    @return  true when no write is running
+  */
+  return !(EECR & _BV(EEPE));
+}  // of method EepromReady()
+void EncoderHAL::EepromWrite(const uint16_t Address, const uint8_t Value) {
+  /*!
+    @brief     Start an erase and write of one EEPROM byte
+    @details   Must only be called when EepromReady() is true. The write runs in the background for
+               about 3.4 milliseconds and the EE_READY interrupt is triggered when it has finished.
+               EEPE has to be set within 4 clock cycles of EEMPE, so interrupts are disabled
+               between the two.
+    @param[in] Address EEPROM address
+    @param[in] Value   New value of the byte
+  */
+  EEAR = Address;
+  EEDR = Value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    EECR = (EECR & _BV(EERIE)) | _BV(EEMPE);  // Erase and write mode, keep the interrupt bit
+    EECR |= _BV(EEPE);                        // Start the write
+  }                                           // of atomic block
+}  // of method EepromWrite()
+void EncoderHAL::EepromInterrupt(const bool Enable) {
+  /*!
+    @brief     Turn the EEPROM ready interrupt on or off
+    @details   While turned on, the interrupt is triggered whenever no write is running
+    @param[in] Enable true to turn the interrupt on
+  */
+  if (Enable)
+    EECR |= _BV(EERIE);
+  else
+    EECR &= ~_BV(EERIE);
+}  // of method EepromInterrupt()
+#elif defined(ROTARY_HAL_HOST)
+uint16_t EncoderHAL::EepromSize() {
+  /*!
+    @brief   Return the size of the simulated EEPROM
+    @return  Number of bytes
+  */
+  return SIM_EEPROM;
+}  // of method EepromSize()
+uint8_t EncoderHAL::EepromRead(const uint16_t Address) {
+  /*!
+    @brief     Read a byte of the simulated EEPROM
+    @param[in] Address EEPROM address
+    @return    Value of the byte, 0xFF outside of the EEPROM
+  */
+  return Address < SIM_EEPROM ? EncoderSimulator::Eeprom[Address] : 0xFF;
+}  // of method EepromRead()
+bool EncoderHAL::EepromReady() {
+  /*!
+    @brief   Return whether a byte can be written
+    @return  true when no simulated write is running
+  */
+  return !EncoderSimulator::EepromBusy;
+}  // of method EepromReady()
+void EncoderHAL::EepromWrite(const uint16_t Address, const uint8_t Value) {
+  /*!
+    @brief     Start a simulated write of one EEPROM byte
+    @param[in] Address EEPROM address
+    @param[in] Value   New value of the byte
+  */
+  EncoderSimulator::EepromWrite(Address, Value);
+}  // of method EepromWrite()
+void EncoderHAL::EepromInterrupt(const bool Enable) {
+  /*!
+    @brief     Turn the simulated EEPROM ready interrupt on or off
+    @param[in] Enable true to turn the interrupt on
+  */
+  EncoderSimulator::EepromInterrupt = Enable;
+}  // of method EepromInterrupt()
+#else
+uint16_t EncoderHAL::EepromSize() {
+  /*!
+    @brief   Return the size of the EEPROM
+    @details This backend has no EEPROM which can be written in the background
+    @return  0
+  */
+  return 0;
+}  // of method EepromSize()
+uint8_t EncoderHAL::EepromRead(const uint16_t Address) {
+  /*!
+    @brief     Read a byte of the EEPROM
+    @param[in] Address EEPROM address (unused)
+    @return    0xFF, the value of an erased byte
+  */
+  (void)Address;
+  return 0xFF;
+}  // of method EepromRead()
+bool EncoderHAL::EepromReady() {
+  /*!
+    @brief   Return whether a byte can be written
+    @return  true, there is nothing to wait for
+  */
+  return true;
+}  // of method EepromReady()
+void EncoderHAL::EepromWrite(const uint16_t Address, const uint8_t Value) {
+  /*!
+    @brief     Start a write of one EEPROM byte
+    @param[in] Address EEPROM address (unused)
+    @param[in] Value   New value of the byte (unused)
+  */
+  (void)Address;
+  (void)Value;
+}  // of method EepromWrite()
+void EncoderHAL::EepromInterrupt(const bool Enable) {
+  /*!
+    @brief     Turn the EEPROM ready interrupt on or off
+    @param[in] Enable true to turn the interrupt on (unused)
+  */
+  (void)Enable;
+}  // of method EepromInterrupt()
+#endif
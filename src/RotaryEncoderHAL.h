@@ -0,0 +1,159 @@
+/*! @file RotaryEncoderHAL.h
+
+@section RotaryEncoderHAL_section Description
+
+Hardware abstraction for the RotaryEncoder library. Everything which depends on the processor, i.e.
+the timer tick used for fading, polling and gestures, the PWM output registers of the LEDs, an
+optional hardware quadrature counter and the EEPROM used by the EncoderStore, is reached through
+the static functions of the EncoderHAL class. The backend is chosen at compile time, so the
+interrupt handlers call the functions directly and no virtual functions or function pointers are
+involved:
+
+- AVR (ROTARY_HAL_AVR): the Timer0 compare interrupts give a tick every 1/2 millisecond and are
+  only turned on while needed, the LED values are written to the PWM compare registers and the
+  encoder pins are decoded in the pin interrupts, as there is no quadrature counter. The EEPROM is
+  written one byte at a time from the EE_READY interrupt.
+- ESP32 (ROTARY_HAL_ESP32): the tick is a periodic esp_timer and each encoder uses one of the
+  pulse counter (PCNT) units, which counts all 4 transitions of every step in hardware with a glitch
+  filter. The timer tick reads the counter and GetEncoderValue() reads the counter register before
+  returning the value. The pulse counter driver of ESP-IDF 5 (Arduino-ESP32 3.x) is used when
+  available and the legacy driver of ESP-IDF 4 (Arduino-ESP32 2.x) otherwise. Processors without a
+  pulse counter, such as the ESP32-C3, and encoders for which no unit is left are decoded in the pin
+  interrupts. Neither the esp_timer nor the counters are set up by the constructors, which may run
+  before the scheduler: the esp_timer is created by the FreeRTOS timer task on the first start and
+  the counters on the first tick. The tick is stopped when idle, as on the AVR, except that an
+  encoder counted in hardware keeps it running to read the counter. The critical section of
+  ATOMIC_BLOCK and ROTARY_ISR_GUARD is a spinlock shared by both cores which only covers the
+  encoder state, so the LEDs are written with analogWrite() by the tick in the esp_timer task,
+  outside of it. All functions which run in an interrupt are placed in IRAM with ROTARY_IRAM, so
+  that they still work while the flash cache is turned off. The EEPROM of the ESP32 is emulated in
+  flash and can't be written from an interrupt, so this backend reports an EEPROM size of 0 and the
+  EncoderStore does nothing.
+- Host (ROTARY_HAL_HOST): used when the library is compiled outside of the Arduino environment. The
+  tick uses the simulated Timer0 registers of "RotaryEncoderSim.h" and, when compiled with
+  ROTARY_SIM_COUNTER set to 1, the simulator provides a quadrature counter so that the counter code
+  can be tested on a desktop computer as well. The EEPROM is simulated too.
+
+A backend which has a counter defines ROTARY_HAL_COUNTER and one whose pins are read from 8-bit PINx
+registers defines ROTARY_HAL_BYTE_PORTS, which the EncoderScanner needs. Other Arduino cores have no
+backend and stop the compilation with an error, which is why "library.properties" only lists the avr
+architecture. To support another processor a new section is added to this file and to
+"RotaryEncoderHAL.cpp" and its architecture is added to "library.properties" once the backend has
+been compiled for it. The ESP32 backend hasn't been yet, so esp32 isn't listed.
+
+@section RotaryEncoderHAL_license License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+
+@section RotaryEncoderHAL_versions Changelog
+
+| Version | Date       | Developer  | Comments
+| ------- | ---------- |------------| --------------------------------------------------------------
+| 1.0.4   | 2026-10-16 | SV-Zanshin | ESP32 tick created on first use and stopped when idle
+| 1.0.3   | 2026-10-16 | SV-Zanshin | CycleCount() uses the CPU cycle counter of the ESP32
+| 1.0.2   | 2026-10-16 | SV-Zanshin | ESP-IDF 5 pulse counter driver, ROTARY_IRAM for the ESP32
+| 1.0.1   | 2026-10-16 | SV-Zanshin | Added the EEPROM functions
+| 1.0.0   | 2026-10-16 | SV-Zanshin | Initial coding
+
+*/
+#ifndef RotaryEncoderHAL_h    // Guard code definition
+  #define RotaryEncoderHAL_h  ///< Define the name inside guard code
+  #if defined(__AVR__)
+    #define ROTARY_HAL_AVR         ///< AVR backend, Timer0 tick and pin interrupts
+    #define ROTARY_HAL_BYTE_PORTS  ///< Pins are read from 8-bit PINx registers
+    #include <util/atomic.h>       // Atomic blocks for multi-byte reads
+  #elif defined(ESP32)
+    #define ROTARY_HAL_ESP32    ///< ESP32 backend, esp_timer tick and PCNT counters
+    #define ROTARY_HAL_COUNTER  ///< Encoders are counted in hardware
+  #elif !defined(ARDUINO)
+    #define ROTARY_HAL_HOST        ///< Host backend, simulated Timer0 and counters
+    #define ROTARY_HAL_BYTE_PORTS  ///< Pins are read from 8-bit PINx registers
+    #ifndef ROTARY_SIM_COUNTER
+      #define ROTARY_SIM_COUNTER 0  ///< Set to 1 to simulate a hardware quadrature counter
+    #endif
+    #if ROTARY_SIM_COUNTER
+      #define ROTARY_HAL_COUNTER  ///< Encoders are counted by the simulated counter
+    #endif
+  #else
+    #error "The RotaryEncoder library only supports the AVR and ESP32 architectures"
+  #endif
+  #define ROTARY_NO_COUNTER 255  ///< Counter unit of an encoder decoded in the pin interrupts
+  #if defined(ROTARY_HAL_ESP32)
+    #define ROTARY_IRAM IRAM_ATTR  ///< Interrupt code must be in IRAM
+    #define ROTARY_DRAM DRAM_ATTR  ///< and so must the tables it reads
+  #else
+    #define ROTARY_IRAM  ///< Code can run from flash in interrupts
+    #define ROTARY_DRAM  ///< and so can tables
+  #endif
+
+  #if defined(ROTARY_HAL_BYTE_PORTS)
+typedef volatile uint8_t EncoderPort;  ///< Input register of an encoder pin
+typedef uint8_t          EncoderMask;  ///< Bit mask of an encoder pin in its input register
+  #else
+typedef volatile uint32_t EncoderPort;  ///< Input register of an encoder pin
+typedef uint32_t          EncoderMask;  ///< Bit mask of an encoder pin in its input register
+  #endif
+
+class EncoderHAL {
+  /*!
+   * @class EncoderHAL
+   * @brief Processor specific timer tick, PWM output and quadrature counter functions
+   */
+ public:
+  static void              TimerStart();    // Start the tick calling EncoderClass::TimerISR()
+  static void              TimerStop();     // Stop the tick when nothing needs it
+  static void              TimerRetry();    // Send a start which couldn't be sent before
+  static bool              TimerRunning();  // true while the tick is running
+  static uint32_t          CycleCount();    // Free running clock for the statistics
+  static uint16_t          CyclesSince(const uint32_t Start);  // CPU cycles since CycleCount()
+  static volatile uint8_t* PWMRegister(const uint8_t Pin, bool& Wide);  // Compare register
+  static uint8_t           CounterBegin(const uint8_t LeftPin, const uint8_t RightPin,
+                                        const bool Pullups);  // Start a counter, get its unit
+  static int16_t           CounterSteps(const uint8_t Unit);  // Transitions since the last call
+  static void              CounterEnd(const uint8_t Unit);    // Stop and free a counter
+  static uint16_t          EepromSize();                      // Bytes of EEPROM, 0 if none
+  static uint8_t           EepromRead(const uint16_t Address);  // Read a byte
+  static bool              EepromReady();                     // true when no write is running
+  static void              EepromWrite(const uint16_t Address, const uint8_t Value);  // Start one
+  static void              EepromInterrupt(const bool Enable);  // EEPROM ready interrupt on/off
+  #if defined(ROTARY_HAL_ESP32)
+  /*!
+   * @class Guard
+   * @brief Critical section which is left when the guard goes out of scope
+   */
+  class Guard {
+   public:
+    Guard() { portENTER_CRITICAL_SAFE(&_Lock); }  ///< Enter the critical section
+    ~Guard() { portEXIT_CRITICAL_SAFE(&_Lock); }  ///< Leave the critical section
+    /*!
+      @brief   Let the ATOMIC_BLOCK loop run exactly once
+      @return  true on the first call, false afterwards
+    */
+    bool Once() {
+      bool first = _First;
+      _First     = false;
+      return first;
+    }  // of method Once()
+   private:
+    bool _First{true};  ///< Set until Once() was called
+  };                    // of class Guard
+ private:
+  static portMUX_TYPE _Lock;  ///< Spinlock shared by both cores
+  #endif
+};  // of class header definition for EncoderHAL
+
+  #if defined(ROTARY_HAL_ESP32)
+    #define ATOMIC_RESTORESTATE 0  ///< Atomic block type, only one type is supported
+    #define ATOMIC_BLOCK(type) \
+      for (EncoderHAL::Guard _rotaryGuard; _rotaryGuard.Once();)  ///< Critical section
+    #define ROTARY_ISR_GUARD EncoderHAL::Guard _rotaryGuard  ///< Lock out the other core
+  #else
+    #define ROTARY_ISR_GUARD  ///< Interrupt handlers can't be interrupted, nothing to do
+  #endif
+#endif
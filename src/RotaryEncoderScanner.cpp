@@ -0,0 +1,210 @@
+/*! @file RotaryEncoderScanner.cpp
+    @section RotaryEncoderScanner_intro_section Description
+
+    Arduino Library for reading a rotary encoder \n\n
+    Multi-encoder port scanner, see the scanner header file for all details
+*/
+#include "RotaryEncoder.h"  // Include the header file
+#if defined(ROTARY_HAL_BYTE_PORTS)  // The scanner reads whole 8-bit ports
+EncoderScanner* EncoderScanner::_Scanners[ROTARY_MAX_SCANNERS];  ///< Registry of active scanners
+EncoderScanner::EncoderScanner(const uint8_t PortPin, const bool HWDebounce)
+    : _PortPin(PortPin), _HWDebounce(HWDebounce) {
+  /*!
+    @brief     Class constructor
+    @details   Looks up the PINx register of the port, encoders are then added with AddEncoder()
+    @param[in] PortPin    Any Arduino pin of the port to scan
+    @param[in] HWDebounce Set to true if the encoders have external pull-up resistors
+  */
+  _Port = portInputRegister(digitalPinToPort(PortPin));
+  for (uint8_t i = 0; i < ROTARY_SCANNER_LANES; i++) _Position[i] = 0;
+}  // of class constructor
+EncoderScanner::~EncoderScanner() {
+  /*!
+    @brief   Class destructor
+    @details Stops scanning so that the interrupt handlers no longer use the instance
+  */
+  End();
+}  // of class destructor
+int8_t EncoderScanner::AddEncoder(const uint8_t LeftPin, const uint8_t RightPin) {
+  /*!
+    @brief     Add an encoder to the scanner
+    @details   Both pins must be on the scanned port and the left pin must be the next higher bit
+               after the right pin, so that the bit-sliced decoding can line up the two pins of
+               each encoder with a single shift. Encoders can only be added while not scanning.
+    @param[in] LeftPin  Arduino pin of the left encoder contact
+    @param[in] RightPin Arduino pin of the right encoder contact
+    @return    Lane number of the encoder, -1 if the pins can't be used
+  */
+  if (_Active || _Lanes == ROTARY_SCANNER_LANES) return -1;  // Running or no free lane
+  if (digitalPinToPort(LeftPin) != digitalPinToPort(_PortPin) ||
+      digitalPinToPort(RightPin) != digitalPinToPort(_PortPin))
+    return -1;  // Not on the scanned port
+  uint8_t right = digitalPinToBitMask(RightPin);
+  if (digitalPinToBitMask(LeftPin) != (uint8_t)(right << 1)) return -1;  // Not neighbouring bits
+  if ((_LeftPins | _RightPins) & (right | (right << 1))) return -1;     // Pins already in use
+  pinMode(LeftPin, INPUT);
+  pinMode(RightPin, INPUT);
+  if (!_HWDebounce) {               // If SW debounce then enable pullup
+    digitalWrite(LeftPin, HIGH);   // Turn the pull-up resistor on
+    digitalWrite(RightPin, HIGH);  // Turn the pull-up resistor on
+  }                                // of if-then hardware or software debounce
+  _LeftPins |= right << 1;
+  _RightPins |= right;
+  _LaneBit[_Lanes]     = right;
+  _LanePins[_Lanes][0] = LeftPin;
+  _LanePins[_Lanes][1] = RightPin;
+  _Position[_Lanes]    = 0;
+  return (int8_t)_Lanes++;
+}  // of method AddEncoder()
+bool EncoderScanner::Begin(const bool UseTimer) {
+  /*!
+    @brief     Start scanning
+    @details   The scanner is stored in the registry and either the pin change interrupts of all
+               lane pins are turned on or the Timer0 compare interrupts are kept running, so that
+               Scan() is called from EncoderClass::PinChangeISR() or EncoderClass::TimerISR()
+    @param[in] UseTimer true to scan from the timer tick, false to scan on pin changes
+    @return    false if the registry is full or pin change interrupts aren't available, which is
+               the case when the sketch doesn't contain the ROTARY_ENCODER_PCINT_VECTORS macro
+  */
+  if (_Active) End();
+  if (!UseTimer && !EncoderClass::_PinChangeWake) return false;  // No PCINT vectors defined
+  _UseTimer = UseTimer;
+  _Last     = *_Port & (_LeftPins | _RightPins);  // Start from the current pin state
+  bool registered = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    for (uint8_t i = 0; i < ROTARY_MAX_SCANNERS; i++) {  // Find the first free registry slot
+      if (_Scanners[i] == nullptr) {                     // and register this scanner there
+        _Scanners[i] = this;
+        registered   = true;
+        break;
+      }  // of if-then slot is free
+    }    // of for-next each registry slot
+    if (registered && UseTimer) EncoderClass::ArmTimer();  // Keep the timer running
+  }                                                        // of atomic block
+  if (!registered) return false;
+  _Active = true;
+  if (!UseTimer && !SetPinChangeMask(true)) {  // Without pin change interrupts
+    End();                                    // the scanner can't run
+    return false;
+  }  // of if-then no pin change interrupts
+  return true;
+}  // of method Begin()
+void EncoderScanner::End() {
+  /*!
+    @brief   Stop scanning
+    @details Turns off the pin change interrupts and removes the scanner from the registry. In
+             timer mode the timer handler turns the timer off on its next tick when nothing else
+             needs it.
+  */
+  if (!_Active) return;
+  if (!_UseTimer) SetPinChangeMask(false);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    for (uint8_t i = 0; i < ROTARY_MAX_SCANNERS; i++) {
+      if (_Scanners[i] == this) _Scanners[i] = nullptr;
+    }  // of for-next each registry slot
+  }    // of atomic block
+  _Active = false;
+}  // of method End()
+bool EncoderScanner::SetPinChangeMask(const bool Enable) {
+  /*!
+    @brief     Turn the pin change interrupts of all lane pins on or off
+    @details   All pins of one port belong to the same pin change interrupt group on the AVR
+               processors, so one PCMSK register holds all of the lane bits
+    @param[in] Enable true to turn the pin change interrupts on, false to turn them off
+    @return    true if the port has pin change interrupts
+  */
+#if defined(digitalPinToPCICR)
+  for (uint8_t i = 0; i < _Lanes; i++) {
+    for (uint8_t p = 0; p < 2; p++) {
+      uint8_t pin = _LanePins[i][p];
+      if (digitalPinToPCICR(pin) == 0) return false;  // The pin has no pin change interrupt
+      if (Enable) {
+        *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));   // Enable the pin
+        *digitalPinToPCICR(pin) |= _BV(digitalPinToPCICRbit(pin));   // and its group
+      } else {
+        *digitalPinToPCMSK(pin) &= ~_BV(digitalPinToPCMSKbit(pin));  // Disable the pin
+      }  // of if-then-else turn on or off
+    }    // of for-next each pin of the lane
+  }      // of for-next each lane
+  return true;
+#else
+  (void)Enable;
+  return false;  // No pin change interrupts on this processor
+#endif
+}  // of method SetPinChangeMask()
+void EncoderScanner::Scan() {
+  /*!
+    @brief   Read the port once and decode all lanes
+    @details The previous and current pin states are packed in one byte with the left pin of each
+             lane one bit above the right pin. For every lane at the same time:
+
+             - changed = old XOR new, shifted so that the left pin change is on the right pin bit
+             - step    = left changed XOR right changed, so exactly one of the two pins changed
+             - cw      = new left XOR old right, which is the clockwise direction of a valid step
+
+             This gives the same result as the 16-entry transition table of EncoderClass, where
+             transitions with no change or with both pins changing are ignored. Only the lanes
+             which stepped are then visited to update their positions.
+  */
+  uint8_t now     = *_Port & (_LeftPins | _RightPins);  // One read of the whole port
+  uint8_t changed = now ^ _Last;                        // Bits which changed since the last scan
+  if (changed == 0) return;                             // Nothing to do, the usual case
+  uint8_t step = ((changed >> 1) ^ changed) & _RightPins;  // Lanes where exactly one pin changed
+  uint8_t cw   = ((now >> 1) ^ _Last) & step;              // and the clockwise ones among them
+  _Last        = now;
+  if (step == 0) return;  // Only invalid transitions
+  for (uint8_t i = 0; i < _Lanes; i++) {
+    if (!(step & _LaneBit[i])) continue;          // Skip lanes which didn't step
+    _Position[i] += (cw & _LaneBit[i]) ? 1 : -1;  // Count the step
+    _Changed |= 1 << i;                           // and mark the lane as changed
+  }  // of for-next each lane
+}  // of method Scan()
+bool EncoderScanner::ScanAll(const bool TimerTick) {
+  /*!
+    @brief     Scan all registered scanners of one mode
+    @details   Called by EncoderClass::TimerISR() and EncoderClass::PinChangeISR()
+    @param[in] TimerTick true when called from the timer tick, false from a pin change interrupt
+    @return    true if any scanner uses the timer tick, so that the timer must keep running
+  */
+  bool found = false;
+  for (uint8_t i = 0; i < ROTARY_MAX_SCANNERS; i++) {
+    EncoderScanner* scanner = _Scanners[i];
+    if (scanner == nullptr || scanner->_UseTimer != TimerTick) continue;
+    scanner->Scan();
+    found = true;
+  }  // of for-next each registry slot
+  return found;
+}  // of method ScanAll()
+int32_t EncoderScanner::GetPosition(const uint8_t Lane) {
+  /*!
+    @brief     Return the position of one encoder
+    @param[in] Lane Lane number returned by AddEncoder()
+    @return    Position, 0 for lanes which aren't in use
+  */
+  if (Lane >= _Lanes) return 0;
+  int32_t position;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { position = _Position[Lane]; }  // Don't read a half-update
+  return position;
+}  // of method GetPosition()
+void EncoderScanner::SetPosition(const uint8_t Lane, const int32_t NewValue) {
+  /*!
+    @brief     Set the position of one encoder
+    @param[in] Lane     Lane number returned by AddEncoder()
+    @param[in] NewValue New position
+  */
+  if (Lane >= _Lanes) return;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { _Position[Lane] = NewValue; }  // Don't write a half-update
+}  // of method SetPosition()
+uint8_t EncoderScanner::GetChanged() {
+  /*!
+    @brief   Return and clear the changed lanes
+    @return  Bit 0 set if lane 0 stepped since the last call, bit 1 for lane 1 and so on
+  */
+  uint8_t changed;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    changed  = _Changed;
+    _Changed = 0;
+  }  // of atomic block
+  return changed;
+}  // of method GetChanged()
+#endif
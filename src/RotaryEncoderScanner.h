@@ -0,0 +1,85 @@
+/*! @file RotaryEncoderScanner.h
+
+@section RotaryEncoderScanner_section Description
+
+Scanner for several plain rotary encoders wired to the same 8-bit port. Instead of one interrupt and
+one call of the rotate handler per encoder, the EncoderScanner reads the whole PINx register once
+and decodes up to 4 encoders at the same time with a handful of bitwise operations on the packed
+previous and current pin states (bit-sliced or "SWAR" decoding), so that 4 encoders cost the same as
+one. The scanner only counts positions, the LEDs, pushbuttons, events and acceleration of
+EncoderClass aren't supported.
+
+The two pins of each encoder must be neighbouring bits of the same port, with the left pin on the
+higher bit, e.g. pins 4 and 5 (PD4 and PD5) of an Arduino Uno with pin 5 as the left pin. The
+decoding follows the same transition table as EncoderClass: a transition where exactly one pin
+changes is a step, and it is clockwise when the new level of the left pin differs from the old
+level of the right pin, which is the 00, 10, 11, 01 gray code sequence. Transitions where both pins
+changed are ignored.
+
+The scanner runs either from the pin change interrupt of the port or from the Timer0 compare tick
+used for fading (2000 times a second). The pin change mode needs the pin change interrupt vectors,
+which are defined by placing the "ROTARY_ENCODER_PCINT_VECTORS" macro in the sketch. The timer mode
+needs no interrupt pins at all and limits the interrupt load to the timer rate, however fast the
+encoders are turned or however much they bounce.
+
+    EncoderScanner Scanner(4);       // Scan the port of pin 4 (PORTD on an Uno)
+    Scanner.AddEncoder(5, 4);        // Lane 0, left pin 5 and right pin 4
+    Scanner.AddEncoder(7, 6);        // Lane 1, left pin 7 and right pin 6
+    Scanner.Begin(true);             // Scan from the timer tick
+    int32_t a = Scanner.GetPosition(0);
+
+@section RotaryEncoderScanner_license License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+
+@section RotaryEncoderScanner_versions Changelog
+
+| Version | Date       | Developer  | Comments
+| ------- | ---------- |------------| --------------------------------------------------------------
+| 1.0.0   | 2026-10-16 | SV-Zanshin | Initial coding
+
+*/
+#ifndef RotaryEncoderScanner_h    // Guard code definition
+  #define RotaryEncoderScanner_h  ///< Define the name inside guard code
+  #define ROTARY_SCANNER_LANES 4  ///< Encoders per 8-bit port
+
+class EncoderScanner {
+  /*!
+   * @class EncoderScanner
+   * @brief Decodes all encoders on one port from a single port read
+   */
+ public:
+  EncoderScanner(const uint8_t PortPin, const bool HWDebounce = false);  // Class constructor
+  ~EncoderScanner();                                                      // Class destructor
+  int8_t      AddEncoder(const uint8_t LeftPin, const uint8_t RightPin);  // Add, return lane
+  bool        Begin(const bool UseTimer = false);  // Start scanning from PCINT or the timer
+  void        End();                               // Stop scanning
+  void        Scan();                              // Read the port and decode all lanes
+  int32_t     GetPosition(const uint8_t Lane);     // Position of one encoder
+  void        SetPosition(const uint8_t Lane, const int32_t NewValue = 0);  // Set a position
+  uint8_t     GetChanged();                        // Lanes changed since the last call
+  static bool ScanAll(const bool TimerTick);       // Called from the interrupt handlers
+ private:
+  bool SetPinChangeMask(const bool Enable);  // Pin change interrupts of the lanes on/off
+  static EncoderScanner* _Scanners[ROTARY_MAX_SCANNERS];      ///< Registry of active scanners
+  volatile uint8_t*      _Port;                               ///< PINx register of the port
+  uint8_t                _PortPin;                            ///< Any pin of the port
+  bool                   _HWDebounce;                         ///< No pull-ups if set
+  bool                   _UseTimer{false};                    ///< Scanned from the timer tick
+  bool                   _Active{false};                      ///< Set while registered
+  uint8_t                _Lanes{0};                           ///< Number of lanes in use
+  uint8_t                _LeftPins{0};                        ///< Port bits of the left pins
+  uint8_t                _RightPins{0};                       ///< Port bits of the right pins
+  uint8_t                _LaneBit[ROTARY_SCANNER_LANES];      ///< Right pin bit of each lane
+  uint8_t                _LanePins[ROTARY_SCANNER_LANES][2];  ///< Arduino pins of each lane
+  uint8_t                _Last{0};                            ///< Previous state of the lane pins
+  volatile uint8_t       _Changed{0};                         ///< Bit per lane set on a step
+  volatile int32_t       _Position[ROTARY_SCANNER_LANES];     ///< Position of each lane
+};  // of class header definition for EncoderScanner
+#endif
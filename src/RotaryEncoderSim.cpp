@@ -0,0 +1,289 @@
+/*! @file RotaryEncoderSim.cpp
+    @section RotaryEncoderSim_intro_section Description
+
+    Host simulation of the Arduino and AVR functions used by the RotaryEncoder library \n\n
+    See the simulation header file for all details. Nothing in this file is compiled when building
+    in the Arduino environment.
+*/
+#if !defined(ARDUINO)
+  #include "RotaryEncoderSim.h"  // Include the header file
+volatile uint8_t EncoderSimulator::PinRegisters[SIM_PINS / 8];  ///< Simulated PINx registers
+volatile uint8_t EncoderSimulator::TimerMask;                   ///< Simulated TIMSK0
+volatile uint8_t EncoderSimulator::TimerCompareA;               ///< Simulated OCR0A
+volatile uint8_t EncoderSimulator::TimerCompareB;               ///< Simulated OCR0B
+uint32_t         EncoderSimulator::Micros;                      ///< Simulated micros() value
+uint32_t         EncoderSimulator::PWMWrites;                   ///< Count of analogWrite() calls
+uint8_t          EncoderSimulator::PWM[SIM_PINS];               ///< Last analogWrite() values
+void (*EncoderSimulator::Handlers[SIM_PINS])();                 ///< Attached pin ISRs
+uint8_t EncoderSimulator::Modes[SIM_PINS];                      ///< Attached pin ISR modes
+volatile int16_t EncoderSimulator::Counters[SIM_COUNTERS];       ///< Simulated counter values
+uint8_t EncoderSimulator::CounterPins[SIM_COUNTERS][2];         ///< Left and right pins, 0 free
+uint8_t EncoderSimulator::Eeprom[SIM_EEPROM];                   ///< Simulated EEPROM contents
+bool    EncoderSimulator::EepromBusy;                           ///< Set while a write is running
+uint32_t      EncoderSimulator::EepromDone;                     ///< Time the write completes
+volatile bool EncoderSimulator::EepromInterrupt;                ///< Simulated EERIE bit
+uint32_t      EncoderSimulator::EepromWrites;                   ///< Count of EEPROM byte writes
+static const bool eepromErased = (EncoderSimulator::EepromErase(), true);  ///< Erased at startup
+void    EncoderSimulator::Reset() {
+  /*!
+    @brief   Reset the simulation
+    @details All pins are set low, time is set to zero, the timer and EEPROM interrupts are
+             disabled and the PWM values and the count of PWM writes are cleared. Attached pin
+             interrupts and quadrature counters are left in place with their counts, since they
+             belong to the encoder instances and the library only reads the change of a count, and
+             the EEPROM keeps its contents like the real one does over a power cycle.
+  */
+  for (uint8_t i = 0; i < SIM_PINS / 8; i++) PinRegisters[i] = 0;
+  for (uint8_t i = 0; i < SIM_PINS; i++) PWM[i] = 0;
+  TimerMask       = 0;
+  EepromBusy      = false;
+  EepromInterrupt = false;
+  Micros    = 0;
+  PWMWrites = 0;
+}  // of method Reset()
+void EncoderSimulator::SetPin(const uint8_t Pin, const uint8_t Level) {
+  /*!
+    @brief     Set the level of a simulated input pin
+    @details   If the level changes and an interrupt is attached to the pin with a matching mode
+               then the interrupt handler is called before returning
+    @param[in] Pin   Simulated pin number
+    @param[in] Level HIGH or LOW
+  */
+  if (Pin >= SIM_PINS) return;                      // Ignore pins which don't exist
+  uint8_t old = GetPin(Pin);                        // Level before the change
+  if (Level)                                        // Set or clear the bit in the
+    PinRegisters[Pin / 8] |= digitalPinToBitMask(Pin);  // simulated PINx register
+  else
+    PinRegisters[Pin / 8] &= ~digitalPinToBitMask(Pin);
+  if (old == (Level ? HIGH : LOW)) return;          // Nothing else to do without an edge
+  for (uint8_t i = 0; i < SIM_COUNTERS; i++) {      // Count the edge in the counters
+    if (CounterPins[i][0] != Pin && CounterPins[i][1] != Pin) continue;  // of this pin
+    uint8_t now  = (GetPin(CounterPins[i][0]) << 1) | GetPin(CounterPins[i][1]);
+    uint8_t then = now ^ (CounterPins[i][0] == Pin ? 0b10 : 0b01);  // State before the edge
+    Counters[i] += ((now >> 1) ^ then) & 1 ? 1 : -1;  // Clockwise when new left != old right
+  }                                                 // of for-next each counter
+  if (Handlers[Pin] == nullptr) return;             // No ISR attached
+  if (Modes[Pin] == CHANGE || (Modes[Pin] == RISING && Level) || (Modes[Pin] == FALLING && !Level))
+    Handlers[Pin]();  // Call the ISR
+}  // of method SetPin()
+uint8_t EncoderSimulator::GetPin(const uint8_t Pin) {
+  /*!
+    @brief     Return the level of a simulated pin
+    @param[in] Pin Simulated pin number
+    @return    HIGH or LOW
+  */
+  if (Pin >= SIM_PINS) return LOW;
+  return (PinRegisters[Pin / 8] & digitalPinToBitMask(Pin)) ? HIGH : LOW;
+}  // of method GetPin()
+void EncoderSimulator::AdvanceMicros(const uint32_t Advance) {
+  /*!
+    @brief     Advance the simulated time
+    @details   Timer0 counts once every 4 microseconds and wraps after 256 counts. Every time the
+               count passes the OCR0A or OCR0B value while the matching TIMSK0 bit is set, the
+               corresponding interrupt vector is called. The EEPROM ready interrupt is checked on
+               every count as well.
+    @param[in] Advance Number of microseconds to advance
+  */
+  uint32_t end = Micros + Advance;                      // Time at the end of the advance
+  while ((int32_t)(end - Micros) > 0) {                 // Step from one timer count to the next
+    uint32_t next = (Micros | 3) + 1;                   // Time of the next Timer0 count
+    if ((int32_t)(next - end) > 0) {                    // If the count isn't reached, then
+      Micros = end;                                     // just advance to the end
+      break;
+    }  // of if-then no more timer counts
+    Micros        = next;                               // Advance to the next count
+    uint8_t count = (uint8_t)(Micros >> 2);             // Timer0 count at this time
+    if ((TimerMask & _BV(OCIE0A)) && count == TimerCompareA) TIMER0_COMPA_vect();
+    if ((TimerMask & _BV(OCIE0B)) && count == TimerCompareB) TIMER0_COMPB_vect();
+    if (EepromBusy && (int32_t)(Micros - EepromDone) >= 0) EepromBusy = false;  // Write done
+    if (EepromInterrupt && !EepromBusy && EE_READY_vect != nullptr) EE_READY_vect();
+  }  // of while-loop time to advance
+}  // of method AdvanceMicros()
+void EncoderSimulator::Replay(const EncoderSimEdge* Trace, const size_t Count) {
+  /*!
+    @brief     Play a recorded or generated waveform
+    @param[in] Trace Array of edges
+    @param[in] Count Number of edges in the array
+  */
+  for (size_t i = 0; i < Count; i++) {
+    AdvanceMicros(Trace[i].delay);
+    SetPin(Trace[i].pin, Trace[i].level);
+  }  // of for-next each edge
+}  // of method Replay()
+size_t EncoderSimulator::GenerateQuadrature(EncoderSimEdge* Trace, const size_t Size,
+                                            const uint8_t LeftPin, const uint8_t RightPin,
+                                            const int32_t Steps, const uint32_t Interval,
+                                            const uint8_t Bounces, const uint32_t BounceMicros) {
+  /*!
+    @brief     Generate the waveform for a number of quadrature steps
+    @details   The waveform starts from the current levels of the two pins and follows the gray code
+               sequence 00, 10, 11, 01 for clockwise steps and the reverse for counterclockwise
+               steps, so each step changes exactly one pin. Each edge can be preceded by a number of
+               bounces, which are short pulses to the new level and back.
+    @param[out] Trace        Array to receive the edges
+    @param[in]  Size         Number of entries in the array
+    @param[in]  LeftPin      Simulated left encoder pin
+    @param[in]  RightPin     Simulated right encoder pin
+    @param[in]  Steps        Number of steps, positive for clockwise and negative counterclockwise
+    @param[in]  Interval     Microseconds between steps
+    @param[in]  Bounces      Number of bounce pulses before each edge
+    @param[in]  BounceMicros Microseconds between bounce edges
+    @return     Number of edges stored in the array
+  */
+  static const uint8_t sequence[4] = {0b00, 0b10, 0b11, 0b01};  // Clockwise gray code sequence
+  uint8_t state = (GetPin(LeftPin) << 1) | GetPin(RightPin);     // Starting pin state
+  uint8_t phase = 0;
+  while (sequence[phase] != state) phase++;                      // Find the starting phase
+  int32_t remaining = Steps < 0 ? -Steps : Steps;
+  size_t  count     = 0;
+  while (remaining-- > 0) {                                      // Add each step
+    phase          = (phase + (Steps < 0 ? 3 : 1)) & 3;          // Next phase in the sequence
+    uint8_t next   = sequence[phase];
+    uint8_t pin    = ((next ^ state) & 0b10) ? LeftPin : RightPin;  // The pin which changes
+    uint8_t level  = ((next ^ state) & 0b10) ? (next >> 1) : (next & 1);
+    uint32_t delay = Interval;
+    for (uint8_t b = 0; b < Bounces && count + 2 < Size; b++) {  // Add the bounce pulses
+      Trace[count++] = {delay, pin, level};
+      Trace[count++] = {BounceMicros, pin, (uint8_t)!level};
+      delay          = BounceMicros;
+    }  // of for-next each bounce
+    if (count >= Size) break;                                    // Stop when the array is full
+    Trace[count++] = {delay, pin, level};                        // The real edge
+    state          = next;
+  }  // of while-loop each step
+  return count;
+}  // of method GenerateQuadrature()
+uint8_t EncoderSimulator::GetPWM(const uint8_t Pin) {
+  /*!
+    @brief     Return the last value written to a pin with analogWrite()
+    @param[in] Pin Simulated pin number
+    @return    PWM value 0-255
+  */
+  return Pin < SIM_PINS ? PWM[Pin] : 0;
+}  // of method GetPWM()
+uint32_t EncoderSimulator::GetPWMWrites() {
+  /*!
+    @brief     Return the number of analogWrite() calls since the last Reset()
+    @return    Number of calls
+  */
+  return PWMWrites;
+}  // of method GetPWMWrites()
+uint8_t EncoderSimulator::AttachCounter(const uint8_t LeftPin, const uint8_t RightPin) {
+  /*!
+    @brief     Attach a pair of pins to a free simulated quadrature counter
+    @details   The counter starts at 0 and counts every transition, clockwise transitions up and
+               counterclockwise ones down. Pin 0 can't be used, as it marks a free counter.
+    @param[in] LeftPin  Simulated pin of the left encoder contact
+    @param[in] RightPin Simulated pin of the right encoder contact
+    @return    Counter unit, 255 if no counter is free or the pins can't be used
+  */
+  if (LeftPin == 0 || RightPin == 0 || LeftPin >= SIM_PINS || RightPin >= SIM_PINS) return 255;
+  for (uint8_t i = 0; i < SIM_COUNTERS; i++) {
+    if (CounterPins[i][0] != 0) continue;  // Counter in use
+    CounterPins[i][0] = LeftPin;
+    CounterPins[i][1] = RightPin;
+    Counters[i]       = 0;
+    return i;
+  }  // of for-next each counter
+  return 255;
+}  // of method AttachCounter()
+void EncoderSimulator::DetachCounter(const uint8_t Unit) {
+  /*!
+    @brief     Stop and free a simulated quadrature counter
+    @param[in] Unit Counter unit returned by AttachCounter()
+  */
+  if (Unit >= SIM_COUNTERS) return;
+  CounterPins[Unit][0] = 0;
+  CounterPins[Unit][1] = 0;
+}  // of method DetachCounter()
+void EncoderSimulator::EepromWrite(const uint16_t Address, const uint8_t Value) {
+  /*!
+    @brief     Start writing one byte of the simulated EEPROM
+    @details   The byte is stored at once, but the EEPROM stays busy for SIM_EEPROM_MICROS of
+               simulated time, just as an AVR erases and writes a byte in about 3.4 milliseconds
+    @param[in] Address EEPROM address, ignored if outside of the EEPROM
+    @param[in] Value   New value of the byte
+  */
+  if (Address >= SIM_EEPROM) return;
+  Eeprom[Address] = Value;
+  EepromBusy      = true;
+  EepromDone      = Micros + SIM_EEPROM_MICROS;
+  EepromWrites++;
+}  // of method EepromWrite()
+void EncoderSimulator::EepromErase() {
+  /*!
+    @brief     Erase the simulated EEPROM
+    @details   Every byte is set to 0xFF, the state of a new or erased AVR EEPROM
+  */
+  for (uint16_t i = 0; i < SIM_EEPROM; i++) Eeprom[i] = 0xFF;
+}  // of method EepromErase()
+void pinMode(uint8_t pin, uint8_t mode) {
+  /*!
+    @brief     Simulated pinMode(), pins modes aren't modelled
+    @param[in] pin  Pin number
+    @param[in] mode Pin mode
+  */
+  (void)pin;
+  (void)mode;
+}  // of function pinMode()
+void digitalWrite(uint8_t pin, uint8_t level) {
+  /*!
+    @brief     Simulated digitalWrite(), only used for the pull-ups which aren't modelled
+    @param[in] pin   Pin number
+    @param[in] level Pin level
+  */
+  (void)pin;
+  (void)level;
+}  // of function digitalWrite()
+int digitalRead(uint8_t pin) {
+  /*!
+    @brief     Simulated digitalRead()
+    @param[in] pin Pin number
+    @return    HIGH or LOW
+  */
+  return EncoderSimulator::GetPin(pin);
+}  // of function digitalRead()
+void analogWrite(uint8_t pin, int value) {
+  /*!
+    @brief     Simulated analogWrite(), stores the value and counts the call
+    @param[in] pin   Pin number
+    @param[in] value PWM value
+  */
+  EncoderSimulator::PWMWrites++;
+  if (pin < SIM_PINS) EncoderSimulator::PWM[pin] = (uint8_t)value;
+}  // of function analogWrite()
+unsigned long millis() {
+  /*!
+    @brief     Simulated millis()
+    @return    Milliseconds of simulated time
+  */
+  return EncoderSimulator::Micros / 1000;
+}  // of function millis()
+unsigned long micros() {
+  /*!
+    @brief     Simulated micros(), with the same 4 microsecond resolution as a 16MHz Arduino
+    @return    Microseconds of simulated time
+  */
+  return EncoderSimulator::Micros & ~3UL;
+}  // of function micros()
+void cli() {}  ///< Interrupts are only called by the simulation driver, so nothing to disable
+void sei() {}  ///< Interrupts are only called by the simulation driver, so nothing to enable
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode) {
+  /*!
+    @brief     Simulated attachInterrupt()
+    @param[in] interrupt Interrupt number, identical to the pin number in the simulation
+    @param[in] handler   Function to call
+    @param[in] mode      CHANGE, RISING or FALLING
+  */
+  if (interrupt >= SIM_PINS) return;
+  EncoderSimulator::Handlers[interrupt] = handler;
+  EncoderSimulator::Modes[interrupt]    = (uint8_t)mode;
+}  // of function attachInterrupt()
+void detachInterrupt(uint8_t interrupt) {
+  /*!
+    @brief     Simulated detachInterrupt()
+    @param[in] interrupt Interrupt number, identical to the pin number in the simulation
+  */
+  if (interrupt < SIM_PINS) EncoderSimulator::Handlers[interrupt] = nullptr;
+}  // of function detachInterrupt()
+#endif
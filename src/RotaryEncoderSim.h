@@ -0,0 +1,158 @@
+/*! @file RotaryEncoderSim.h
+
+@section RotaryEncoderSim_section Description
+
+Host simulation of the Arduino and AVR functions used by the RotaryEncoder library. When the library
+is compiled outside of the Arduino environment (the "ARDUINO" macro isn't defined) this file is
+included instead of "Arduino.h", so that "RotaryEncoder.cpp" can be compiled and run natively on a
+desktop computer to measure and regression-test the interrupt handlers.
+
+The simulation models 32 digital pins spread over 4 8-bit PINx registers. The first
+SIM_INTERRUPT_PINS of them can have an interrupt attached, the others have none, like most pins of
+an ATmega328P, so that pins without an interrupt can be tested too. Also modelled are the Timer0
+compare interrupts used for fading. Time only advances when EncoderSimulator::AdvanceMicros() is
+called. Timer0 runs at the Arduino rate of 4 microseconds per count with a period of 1024
+microseconds, so the TIMER0_COMPA_vect and TIMER0_COMPB_vect handlers are called at counts 64 and
+192 of each period when enabled in TIMSK0. Setting a pin level with EncoderSimulator::SetPin()
+calls the attached CHANGE, RISING or FALLING interrupt handler immediately, just as the hardware
+would.
+
+Up to SIM_COUNTERS pairs of pins can be attached to a simulated quadrature counter with
+EncoderSimulator::AttachCounter(), which counts every transition of the pins like the pulse counter
+of an ESP32 would. It is used by the host backend of "RotaryEncoderHAL.h" when the library is
+compiled with ROTARY_SIM_COUNTER set to 1.
+
+The simulated EEPROM of SIM_EEPROM bytes starts out erased (0xFF) and keeps its contents across
+EncoderSimulator::Reset(), so that a power cycle can be simulated. A write takes SIM_EEPROM_MICROS
+of simulated time, during which no other byte can be written, and while the ready interrupt is
+enabled the EE_READY_vect handler is called whenever no write is in progress, as on an AVR.
+
+Waveforms are fed to the library as arrays of EncoderSimEdge records, each of which waits a number
+of microseconds and then sets a pin level. These can be recorded from real hardware or built with
+EncoderSimulator::GenerateQuadrature(), which can also add contact bounce to every edge.
+
+@section RotaryEncoderSim_license License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+
+@section RotaryEncoderSim_versions Changelog
+
+| Version | Date       | Developer  | Comments
+| ------- | ---------- |------------| --------------------------------------------------------------
+| 1.0.5   | 2026-10-16 | SV-Zanshin | Pins from SIM_INTERRUPT_PINS on have no interrupt
+| 1.0.4   | 2026-10-16 | SV-Zanshin | Added the simulated EEPROM and its ready interrupt
+| 1.0.3   | 2026-10-16 | SV-Zanshin | Added simulated quadrature counters
+| 1.0.2   | 2026-10-16 | SV-Zanshin | Added pgm_read_dword()
+| 1.0.1   | 2026-10-16 | SV-Zanshin | Added the Timer0 counter TCNT0
+| 1.0.0   | 2026-10-16 | SV-Zanshin | Initial coding
+
+*/
+#ifndef RotaryEncoderSim_h    // Guard code definition
+  #define RotaryEncoderSim_h  ///< Define the name inside guard code
+  #include <stddef.h>         // Standard size types
+  #include <stdint.h>         // Standard integer types
+
+  #define HIGH              0x1                ///< Pin level high
+  #define LOW               0x0                ///< Pin level low
+  #define INPUT             0x0                ///< Pin mode input
+  #define OUTPUT            0x1                ///< Pin mode output
+  #define INPUT_PULLUP      0x2                ///< Pin mode input with pull-up
+  #define CHANGE            1                  ///< Interrupt on any change
+  #define FALLING           2                  ///< Interrupt on falling edge
+  #define RISING            3                  ///< Interrupt on rising edge
+  #define NOT_AN_INTERRUPT  -1                 ///< Pin has no interrupt
+  #define SIM_PINS          32                 ///< Number of simulated digital pins
+  #define SIM_INTERRUPT_PINS 24                ///< Pins below this number have an interrupt
+  #define SIM_COUNTERS      4                  ///< Number of simulated quadrature counters
+  #define SIM_EEPROM        1024               ///< Size of the simulated EEPROM in bytes
+  #define SIM_EEPROM_MICROS 3400               ///< Duration of a simulated EEPROM write
+  #define PROGMEM                              ///< No separate program memory on the host
+  #define _BV(bit)          (1 << (bit))       ///< Bit value macro from avr-libc
+  #define pgm_read_byte(p)  (*(const uint8_t*)(p))   ///< Program memory byte read
+  #define pgm_read_word(p)  (*(const uint16_t*)(p))  ///< Program memory word read
+  #define pgm_read_dword(p) (*(const uint32_t*)(p))  ///< Program memory double word read
+  #define digitalPinToInterrupt(p) \
+    ((p) < SIM_INTERRUPT_PINS ? (int)(p) : NOT_AN_INTERRUPT)  ///< Interrupt number of a pin
+  #define digitalPinToPort(p)      ((uint8_t)((p) / 8))                   ///< 8 pins per port
+  #define digitalPinToBitMask(p)   ((uint8_t)(1 << ((p) % 8)))            ///< Bit in the port
+  #define portInputRegister(port)  (&EncoderSimulator::PinRegisters[port])  ///< PINx register
+  #define ISR(vector)              extern "C" void vector(void)           ///< Interrupt vector
+  #define ATOMIC_RESTORESTATE      0                                      ///< Atomic block type
+  #define ATOMIC_BLOCK(type)       for (uint8_t _sim_once = 1; _sim_once; _sim_once = 0)  ///< Once
+  #define TIMSK0                   EncoderSimulator::TimerMask     ///< Timer0 interrupt mask
+  #define OCR0A                    EncoderSimulator::TimerCompareA  ///< Timer0 compare A
+  #define OCR0B                    EncoderSimulator::TimerCompareB  ///< Timer0 compare B
+  #define TCNT0                    ((uint8_t)(EncoderSimulator::Micros >> 2))  ///< Timer0 count
+  #define OCIE0A                   1                                ///< Compare A enable bit
+  #define OCIE0B                   2                                ///< Compare B enable bit
+
+extern "C" void TIMER0_COMPA_vect(void);  // Defined by the library with the ISR() macro
+extern "C" void TIMER0_COMPB_vect(void);  // Defined by the library with the ISR() macro
+extern "C" void EE_READY_vect(void) __attribute__((weak));  // Defined by the sketch, if at all
+
+struct EncoderSimEdge {
+  /*!
+   * @struct EncoderSimEdge
+   * @brief  One step of a simulated waveform, wait "delay" microseconds then set the pin level
+   */
+  uint32_t delay;  ///< Microseconds to advance before the edge
+  uint8_t  pin;    ///< Simulated pin number
+  uint8_t  level;  ///< New pin level, HIGH or LOW
+};                 // of structure EncoderSimEdge
+
+class EncoderSimulator {
+  /*!
+   * @class EncoderSimulator
+   * @brief Static state and driver functions of the host simulation
+   */
+ public:
+  static void     Reset();                                       // Reset pins, time and timer
+  static void     SetPin(const uint8_t Pin, const uint8_t Level);  // Set level, call pin ISR
+  static uint8_t  GetPin(const uint8_t Pin);                     // Current pin level
+  static void     AdvanceMicros(const uint32_t Advance);         // Advance time, call timer ISRs
+  static void     Replay(const EncoderSimEdge* Trace, const size_t Count);  // Play a waveform
+  static size_t   GenerateQuadrature(EncoderSimEdge* Trace, const size_t Size,  // Build waveform
+                                     const uint8_t LeftPin, const uint8_t RightPin,
+                                     const int32_t Steps, const uint32_t Interval,
+                                     const uint8_t Bounces = 0, const uint32_t BounceMicros = 20);
+  static uint8_t  GetPWM(const uint8_t Pin);                     // Last analogWrite() value
+  static uint32_t GetPWMWrites();                                // Number of analogWrite() calls
+  static uint8_t  AttachCounter(const uint8_t LeftPin, const uint8_t RightPin);  // Count pins
+  static void     DetachCounter(const uint8_t Unit);             // Stop and free a counter
+  static void     EepromWrite(const uint16_t Address, const uint8_t Value);  // Start a write
+  static void     EepromErase();                                 // Set every byte to 0xFF
+  static volatile uint8_t PinRegisters[SIM_PINS / 8];            ///< Simulated PINx registers
+  static volatile uint8_t TimerMask;                             ///< Simulated TIMSK0
+  static volatile uint8_t TimerCompareA;                         ///< Simulated OCR0A
+  static volatile uint8_t TimerCompareB;                         ///< Simulated OCR0B
+  static uint32_t         Micros;                                ///< Simulated micros() value
+  static uint32_t         PWMWrites;                             ///< Count of analogWrite() calls
+  static uint8_t          PWM[SIM_PINS];                         ///< Last analogWrite() values
+  static void (*Handlers[SIM_PINS])();                           ///< Attached pin ISRs
+  static uint8_t          Modes[SIM_PINS];                       ///< Attached pin ISR modes
+  static volatile int16_t Counters[SIM_COUNTERS];                ///< Simulated counter values
+  static uint8_t          CounterPins[SIM_COUNTERS][2];          ///< Left and right pins, 0 free
+  static uint8_t          Eeprom[SIM_EEPROM];                    ///< Simulated EEPROM contents
+  static bool             EepromBusy;                            ///< Set while a write is running
+  static uint32_t         EepromDone;                            ///< Time the write completes
+  static volatile bool    EepromInterrupt;                       ///< Simulated EERIE bit
+  static uint32_t         EepromWrites;                          ///< Count of EEPROM byte writes
+};  // of class header definition for EncoderSimulator
+
+void          pinMode(uint8_t pin, uint8_t mode);              // Arduino pin functions
+void          digitalWrite(uint8_t pin, uint8_t level);
+int           digitalRead(uint8_t pin);
+void          analogWrite(uint8_t pin, int value);
+unsigned long millis();                                        // Arduino time functions
+unsigned long micros();
+void          cli();                                           // Interrupt control functions
+void          sei();
+void          attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void          detachInterrupt(uint8_t interrupt);
+#endif
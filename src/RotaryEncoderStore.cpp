@@ -0,0 +1,233 @@
+/*! @file RotaryEncoderStore.cpp
+    @section RotaryEncoderStore_intro_section Description
+
+    Arduino Library for reading a rotary encoder \n\n
+    Wear-leveled EEPROM persistence, see the store header file for all details
+*/
+#include "RotaryEncoder.h"  // Include the header file
+EncoderStore* volatile EncoderStore::_Writer{nullptr};  ///< Store whose record is being written
+bool                   EncoderStore::_ReadyInterrupt{false};  ///< Set by the EEPROM vector macro
+EncoderStore::EncoderStore(EncoderClass& Encoder, const uint16_t Address, const uint8_t Slots)
+    : _Encoder(Encoder), _Address(Address), _Slots(Slots) {
+  /*!
+    @brief     Class constructor
+    @details   Only stores the parameters, the EEPROM is first read by Restore() or Service(). The
+               number of slots is reduced if the ring doesn't fit into the EEPROM, if not even one
+               slot fits or the processor has no EEPROM then the store does nothing.
+    @param[in] Encoder Encoder whose value and colors are saved
+    @param[in] Address EEPROM address of the first slot
+    @param[in] Slots   Number of 16 byte slots of the ring, the more the less each one is written
+  */
+  uint16_t size = EncoderHAL::EepromSize();
+  uint16_t fit  = Address < size ? (size - Address) / sizeof(EncoderRecord) : 0;
+  if (_Slots > fit) _Slots = fit;  // Only use the slots which fit
+}  // of class constructor
+EncoderStore::~EncoderStore() {
+  /*!
+    @brief   Class destructor
+    @details A record which is still being written is abandoned, so that the ready interrupt no
+             longer uses the instance and other stores can write again. The slot was invalidated
+             by the first byte written, see WriteNext(), so Restore() finds the previous record.
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (_Writer == this) {                 // Still writing,
+      _Writer = nullptr;                   // so release the EEPROM
+      EncoderHAL::EepromInterrupt(false);  // and stop the interrupt
+    }                                      // of if-then writing
+  }                                        // of atomic block
+}  // of class destructor
+bool EncoderStore::UseReadyInterrupt() {
+  /*!
+    @brief     Note that the EE_READY interrupt vector exists
+    @details   Called once by the "ROTARY_ENCODER_EEPROM_VECTOR" macro, after which the records are
+               written from the interrupt instead of from Service()
+    @return    true
+  */
+  _ReadyInterrupt = true;
+  return true;
+}  // of method UseReadyInterrupt()
+void EncoderStore::SetIdleTime(const uint16_t Millis) {
+  /*!
+    @brief     Set the time the state must be left unchanged before it is saved
+    @details   Every change restarts the time, so a knob which is being turned isn't saved until it
+               has come to rest
+    @param[in] Millis Idle time in milliseconds
+  */
+  _IdleMillis = Millis;
+}  // of method SetIdleTime()
+bool EncoderStore::Restore() {
+  /*!
+    @brief     Apply the newest saved record to the encoder
+    @details   Scans the slots, see Scan(), and sets the encoder value and the colors to those of
+               the newest valid record. Meant to be called once in setup(). On a blank EEPROM the
+               encoder is left unchanged and its current state is taken as already saved, so the
+               first record is only written once the state changes.
+    @return    true if a record was found, false if the encoder was left unchanged
+  */
+  if (_Slots == 0 || _Writer == this) return false;  // No EEPROM or busy writing
+  if (!Scan()) return false;                          // Nothing saved yet
+  _Encoder.SetEncoderValue(_Record.value);
+  _Encoder.SetPushButtonColor(_Record.colors[0], _Record.colors[1], _Record.colors[2]);
+  _Encoder.SetCWTurnColor(_Record.colors[3], _Record.colors[4], _Record.colors[5]);
+  _Encoder.SetCCWTurnColor(_Record.colors[6], _Record.colors[7], _Record.colors[8]);
+  _Seen = _Record;  // The encoder now matches the saved state
+  return true;
+}  // of method Restore()
+bool EncoderStore::Scan() {
+  /*!
+    @brief     Find the newest valid record
+    @details   Reads every slot once. Slots whose checksum doesn't match, because they were never
+               written or the power failed while writing them, are skipped. Of the others the one
+               with the highest sequence number is the newest, the comparison is done on the 16-bit
+               difference so that it still works after the sequence number wraps around. The next
+               record goes into the slot after the newest, which holds the oldest record. If there
+               is no valid record the current state of the encoder is taken as saved, so that
+               nothing is written until it changes.
+    @return    true if a valid record was found
+  */
+  EncoderRecord record;
+  uint8_t*      bytes = (uint8_t*)&record;
+  bool          found = false;
+  for (uint8_t slot = 0; slot < _Slots; slot++) {  // Read each slot
+    uint16_t address = _Address + slot * sizeof(EncoderRecord);
+    for (uint8_t i = 0; i < sizeof(EncoderRecord); i++)  // Copy the slot
+      bytes[i] = EncoderHAL::EepromRead(address + i);
+    if (record.check != Check(record)) continue;  // Skip empty and damaged slots
+    if (found && (int16_t)(record.sequence - _Record.sequence) <= 0) continue;  // and older ones
+    _Record = record;
+    _Slot   = slot;
+    found   = true;
+  }  // of for-next each slot
+  _Scanned = true;
+  if (found) {
+    _Sequence = _Record.sequence + 1;
+    _Slot     = (_Slot + 1) % _Slots;  // The oldest record is overwritten next
+  } else {
+    _Sequence = 0;
+    _Slot     = 0;
+    Capture(_Record);  // Nothing to save until the state changes
+  }                    // of if-then-else record found
+  _Seen = _Record;
+  return found;
+}  // of method Scan()
+bool EncoderStore::Service() {
+  /*!
+    @brief     Save the state of the encoder once it has been idle
+    @details   Called from loop(). Compares the state of the encoder with the state seen at the last
+               call, every change restarts the idle time. Once the state has been unchanged for the
+               idle time and differs from the newest record, a new record is built and its first
+               byte is written. The remaining bytes are written from the EE_READY interrupt or,
+               without the interrupt vector, by the following calls. Never waits for the EEPROM.
+    @return    true while there are unsaved changes or a record is being written, so that the
+               sketch knows not to power down yet
+  */
+  if (_Slots == 0) return false;  // Nothing to do without an EEPROM
+  if (!_Scanned) Scan();          // Find the slot to write to
+  if (_Writer == this) {          // Still writing the last record
+    if (!_ReadyInterrupt && EncoderHAL::EepromReady()) WriteNext();  // Write the next byte here
+    return true;
+  }  // of if-then writing
+  EncoderRecord now;
+  Capture(now);
+  if (!Same(now, _Seen)) {     // The state has changed,
+    _Seen         = now;       // so remember it and start the
+    _ChangeMillis = millis();  // idle time again
+  }                            // of if-then changed
+  if (Same(_Seen, _Record)) return false;                 // Already saved
+  if (millis() - _ChangeMillis < _IdleMillis) return true;  // Not idle long enough yet
+  if (_Writer != nullptr) return true;                    // Another store is writing
+  _Record          = _Seen;  // Build the new record
+  _Record.sequence = _Sequence++;
+  _Record.check    = Check(_Record);
+  _WriteAddress    = _Address + _Slot * sizeof(EncoderRecord);
+  _Slot            = (_Slot + 1) % _Slots;
+  _Byte            = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { _Writer = this; }
+  if (_ReadyInterrupt)
+    EncoderHAL::EepromInterrupt(true);  // The interrupt writes the bytes
+  else if (EncoderHAL::EepromReady())
+    WriteNext();  // or write the first one now
+  return true;
+}  // of method Service()
+void EncoderStore::ReadyISR() {
+  /*!
+    @brief   Handler for the EE_READY interrupt
+    @details Called whenever the EEPROM is ready while the interrupt is turned on, starts the write
+             of the next byte of the record or turns the interrupt off when the record is complete
+  */
+  if (_Writer != nullptr)
+    _Writer->WriteNext();
+  else
+    EncoderHAL::EepromInterrupt(false);  // Nothing to write
+}  // of method ReadyISR()
+void EncoderStore::WriteNext() {
+  /*!
+    @brief   Start writing the next byte of the record which differs from the EEPROM
+    @details Bytes which already have the right value are skipped, which saves both time and wear,
+             as consecutive records often only differ in the value and the sequence number. The
+             checksum is written twice, first as the complement of the new checksum so that the
+             slot is invalid while the other bytes are written, and last with its real value. A
+             power failure part way through the record therefore never leaves the old checksum
+             in front of a mix of old and new bytes. Once the record is complete the EEPROM is
+             released for the other stores. Must only be called when the EEPROM is ready.
+  */
+  const uint8_t* bytes = (const uint8_t*)&_Record;
+  while (_Byte <= sizeof(EncoderRecord)) {  // Invalidate, then find the next byte to change
+    uint8_t step  = _Byte++;
+    uint8_t i     = step ? step - 1 : sizeof(EncoderRecord) - 1;  // Checksum first and last
+    uint8_t value = step ? bytes[i] : (uint8_t)~_Record.check;     // first as an invalid one
+    if (EncoderHAL::EepromRead(_WriteAddress + i) == value) continue;  // Already right
+    EncoderHAL::EepromWrite(_WriteAddress + i, value);
+    return;  // The ready interrupt or Service() continues
+  }          // of while-loop each byte
+  _Writer = nullptr;                   // The record is complete
+  EncoderHAL::EepromInterrupt(false);  // and the interrupt is no longer needed
+}  // of method WriteNext()
+void EncoderStore::Capture(EncoderRecord& Record) {
+  /*!
+    @brief      Copy the state of the encoder into a record
+    @details    The value is read atomically with GetEncoderValue32(), the colors are only changed
+                by the main program and can be copied directly
+    @param[out] Record Record to receive the value and the colors
+  */
+  Record.value     = _Encoder.GetEncoderValue32();
+  Record.colors[0] = _Encoder._ColorPushButtonR;
+  Record.colors[1] = _Encoder._ColorPushButtonG;
+  Record.colors[2] = _Encoder._ColorPushButtonB;
+  Record.colors[3] = _Encoder._ColorCWR;
+  Record.colors[4] = _Encoder._ColorCWG;
+  Record.colors[5] = _Encoder._ColorCWB;
+  Record.colors[6] = _Encoder._ColorCCWR;
+  Record.colors[7] = _Encoder._ColorCCWG;
+  Record.colors[8] = _Encoder._ColorCCWB;
+}  // of method Capture()
+bool EncoderStore::Same(const EncoderRecord& A, const EncoderRecord& B) {
+  /*!
+    @brief     Compare the saved state of two records
+    @details   The sequence number and the checksum aren't part of the state
+    @param[in] A First record
+    @param[in] B Second record
+    @return    true if the value and all colors are the same
+  */
+  if (A.value != B.value) return false;
+  for (uint8_t i = 0; i < sizeof(A.colors); i++)
+    if (A.colors[i] != B.colors[i]) return false;
+  return true;
+}  // of method Same()
+uint8_t EncoderStore::Check(const EncoderRecord& Record) {
+  /*!
+    @brief     Compute the checksum of a record
+    @details   CRC-8 with the polynomial 0x31 and a start value of 0xFF over every byte but the
+               checksum itself. Neither an erased slot (all 0xFF) nor a cleared one (all 0x00) has
+               a matching checksum.
+    @param[in] Record Record to check
+    @return    CRC-8 of the record
+  */
+  const uint8_t* bytes = (const uint8_t*)&Record;
+  uint8_t        crc   = 0xFF;
+  for (uint8_t i = 0; i < sizeof(EncoderRecord) - 1; i++) {  // Every byte but the checksum
+    crc ^= bytes[i];
+    for (uint8_t bit = 0; bit < 8; bit++) crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+  }  // of for-next each byte
+  return crc;
+}  // of method Check()
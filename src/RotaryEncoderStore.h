@@ -0,0 +1,114 @@
+/*! @file RotaryEncoderStore.h
+
+@section RotaryEncoderStore_section Description
+
+Persistence of the encoder value and the pushbutton, clockwise and counterclockwise colors of an
+EncoderClass instance in the EEPROM, so that they can be restored after a power loss. Writing the
+EEPROM from loop() on every change would wear the cells out and stall the program for about 3.4ms
+per byte, so the EncoderStore works as follows:
+
+- Changes are coalesced. A record is only written once the state has been left unchanged for the
+  idle time set with SetIdleTime(), 2 seconds by default, so turning the knob from 0 to 100 causes
+  one write and not 100.
+- The records are written to a ring of slots in turn, so every slot is only written once for every
+  "Slots" saves, and bytes which already have the right value aren't written at all. Each 16 byte
+  record holds a sequence number and a CRC-8 checksum. The checksum is first overwritten with an
+  invalid value and only written last, so a record which was only partly written when the power
+  failed is ignored and the previous one is used.
+- The bytes are written in the background. Service() only starts a write and returns at once, and
+  the following bytes are written from the EE_READY interrupt, which is triggered each time the
+  EEPROM has finished a byte. The interrupt vector is defined by placing the
+  "ROTARY_ENCODER_EEPROM_VECTOR" macro in the sketch. Without it the bytes are written by the
+  following calls of Service(), one byte each time the EEPROM is ready, which doesn't block either.
+- Restore() finds the newest record with a single pass over the slots, comparing the sequence
+  numbers of the valid records, and applies it to the encoder. If there is no valid record, as on a
+  blank EEPROM, the encoder is left as it is and its current state counts as saved, so nothing is
+  written until the state is changed.
+
+    EncoderClass Encoder(2, 3, 4, 9, 10, 11);
+    EncoderStore Store(Encoder, 0, 16);  // 16 slots of 16 bytes from EEPROM address 0
+    ROTARY_ENCODER_EEPROM_VECTOR         // Write the EEPROM in the background
+    void setup() { Store.Restore(); }    // Value and colors from the last save
+    void loop() { Store.Service(); }     // Save changes once the encoder is idle
+
+Several encoders can each have a store, as long as the EEPROM areas don't overlap. Only one record
+is written at a time, the others wait in Service() until the EEPROM is free.
+
+@section RotaryEncoderStore_license License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+
+@section RotaryEncoderStore_versions Changelog
+
+| Version | Date       | Developer  | Comments
+| ------- | ---------- |------------| --------------------------------------------------------------
+| 1.0.1   | 2026-10-16 | SV-Zanshin | Destructor releases the EEPROM
+| 1.0.0   | 2026-10-16 | SV-Zanshin | Initial coding
+
+*/
+#ifndef RotaryEncoderStore_h    // Guard code definition
+  #define RotaryEncoderStore_h  ///< Define the name inside guard code
+  #if defined(ROTARY_HAL_AVR) && !defined(EE_READY_vect) && defined(EE_RDY_vect)
+    #define EE_READY_vect EE_RDY_vect  ///< Older processors call the vector EE_RDY_vect
+  #endif
+  #if defined(ROTARY_HAL_HOST) || (defined(ROTARY_HAL_AVR) && defined(EE_READY_vect))
+    #define ROTARY_ENCODER_EEPROM_VECTOR                  \
+      ISR(EE_READY_vect) { EncoderStore::ReadyISR(); } \
+      static const bool rotaryEncoderEEPROM = EncoderStore::UseReadyInterrupt();  ///< In use
+  #else
+    #define ROTARY_ENCODER_EEPROM_VECTOR  ///< No EEPROM ready interrupt, Service() writes
+  #endif
+
+struct EncoderRecord {
+  /*!
+   * @struct EncoderRecord
+   * @brief  One saved state of an encoder, as stored in each EEPROM slot
+   */
+  int32_t  value;      ///< Encoder value
+  uint16_t sequence;   ///< Incremented for every record written, the newest has the highest
+  uint8_t  colors[9];  ///< Pushbutton, clockwise and counterclockwise colors, R, G and B each
+  uint8_t  check;      ///< CRC-8 of the other bytes, written last
+};                     // of structure EncoderRecord
+
+class EncoderStore {
+  /*!
+   * @class EncoderStore
+   * @brief Saves and restores the state of an encoder in a wear-leveled EEPROM ring
+   */
+ public:
+  EncoderStore(EncoderClass& Encoder, const uint16_t Address = 0,
+               const uint8_t Slots = 16);          // Class constructor
+  ~EncoderStore();                                 // Class destructor
+  bool        Restore();                           // Apply the newest saved record
+  bool        Service();                           // Save changes once idle, call from loop()
+  void        SetIdleTime(const uint16_t Millis);  // Time without changes before saving
+  static void ReadyISR();                          // Called from the EE_READY vector
+  static bool UseReadyInterrupt();                 // Set by the EEPROM vector macro
+ private:
+  bool           Scan();                                 // Find the newest record
+  void           Capture(EncoderRecord& Record);         // Copy the state of the encoder
+  void           WriteNext();                            // Start writing the next changed byte
+  static bool    Same(const EncoderRecord& A, const EncoderRecord& B);  // Same state?
+  static uint8_t Check(const EncoderRecord& Record);     // CRC-8 of a record
+  static EncoderStore* volatile _Writer;                 ///< Store whose record is being written
+  static bool                   _ReadyInterrupt;         ///< Set when the EE_READY vector exists
+  EncoderClass&                 _Encoder;                ///< Encoder whose state is saved
+  uint16_t                      _Address;                ///< EEPROM address of the first slot
+  uint8_t                       _Slots;                  ///< Number of slots, 0 if no EEPROM
+  uint8_t                       _Slot{0};                ///< Slot of the next record
+  uint16_t                      _Sequence{0};            ///< Sequence number of the next record
+  bool                          _Scanned{false};         ///< Set once the slots were scanned
+  uint16_t                      _IdleMillis{2000};       ///< Unchanged time before saving
+  uint32_t                      _ChangeMillis{0};        ///< millis() of the last change
+  uint16_t                      _WriteAddress{0};        ///< EEPROM address of the record written
+  volatile uint8_t              _Byte{0};                ///< Write step, 0 invalidates the checksum
+  EncoderRecord                 _Record{};               ///< Newest record, saved or being saved
+  EncoderRecord                 _Seen{};                 ///< State at the last Service() call
+};  // of class header definition for EncoderStore
+#endif
@@ -0,0 +1,150 @@
+/*! @file RotaryEncoderTemplate.h
+
+@section RotaryEncoderTemplate_section Description
+
+Compile-time front-end for the RotaryEncoder library. The RotaryEncoder class template takes the
+pins as template parameters instead of constructor arguments and is used exactly like EncoderClass,
+from which it is derived:
+
+    RotaryEncoder<2, 3, 4, 9, 10, 11> Encoder;  // Left, right, pushbutton, red, green, blue
+
+Because the pins are constants, every template instance has its own static interrupt trampolines
+which call the instance directly, without the registry lookup that EncoderClass needs. On the
+ATmega328P and ATmega168 (Arduino Uno, Nano, Pro Mini, Pro Trinket) the pin numbers are also mapped
+to their PINx registers and bits at compile time, so that the rotate interrupt reads the encoder
+pins from constant I/O addresses instead of through the pointers looked up by the constructor. The
+port and bit of a pin are taken from the digitalPinToPCICRbit() and digitalPinToPCMSKbit() macros
+of the board's variant, and other processors, such as the ATmega32U4 of the Leonardo or the
+ATmega2560 of the Mega, use the PINx addresses looked up by the EncoderClass constructor. No flash
+or cycle savings have been measured on AVR hardware. The LED writer is chosen from the
+LED pin parameters, so that the fader only writes the LEDs which exist without testing the pins.
+
+The encoder pins are checked at compile time on AVR processors, so an encoder pin which has no
+external interrupt is an error instead of an encoder which silently doesn't work. The pushbutton
+can be on any pin, as on the ATmega328P and ATmega168 only pins 2 and 3 have an external interrupt.
+A pushbutton pin without one is sampled and debounced on the timer tick instead.
+
+Each combination of pins can only be used for one instance, which is always the case since two
+encoders can't share their pins. The fader and the registry are shared with EncoderClass, so both
+can be used in the same sketch.
+
+@section RotaryEncoderTemplate_license License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+
+@section RotaryEncoderTemplate_versions Changelog
+
+| Version | Date       | Developer  | Comments
+| ------- | ---------- |------------| --------------------------------------------------------------
+| 1.0.2   | 2026-10-16 | SV-Zanshin | Compile-time ports taken from the variant's pin macros
+| 1.0.1   | 2026-10-16 | SV-Zanshin | Pushbutton on any pin, LED writer chosen at compile time
+| 1.0.0   | 2026-10-16 | SV-Zanshin | Initial coding
+
+*/
+#ifndef RotaryEncoderTemplate_h    // Guard code definition
+  #define RotaryEncoderTemplate_h  ///< Define the name inside guard code
+  #if (defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) ||  \
+       defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__)) && \
+      defined(digitalPinToPCICRbit) && defined(digitalPinToPCMSKbit)
+    #define ROTARY_STATIC_PINS  ///< Pin numbers can be mapped to PINx registers at compile time
+  #endif
+
+template <uint8_t LeftPin, uint8_t RightPin, uint8_t PushbuttonPin, uint8_t RedPin = 255,
+          uint8_t GreenPin = 255, uint8_t BluePin = 255, bool HWDebounce = false>
+class RotaryEncoder : public EncoderClass {
+  /*!
+   * @class RotaryEncoder
+   * @brief Rotary encoder with the pins set at compile time
+   */
+ public:
+  RotaryEncoder();   // Class constructor
+  ~RotaryEncoder();  // Class destructor
+ private:
+  #if defined(ROTARY_STATIC_PINS)
+  template <uint8_t Pin>
+  static uint8_t ReadPin();  // Read a pin with a compile-time address
+  #endif
+  static void           RotateISR();      // Trampoline for the rotate interrupts
+  static void           PushButtonISR();  // Trampoline for the pushbutton interrupt
+  static RotaryEncoder* _Self;            ///< The instance using these pins
+};  // of class header definition for RotaryEncoder
+
+template <uint8_t L, uint8_t R, uint8_t P, uint8_t RP, uint8_t GP, uint8_t BP, bool D>
+RotaryEncoder<L, R, P, RP, GP, BP, D>* RotaryEncoder<L, R, P, RP, GP, BP, D>::_Self{nullptr};
+
+template <uint8_t L, uint8_t R, uint8_t P, uint8_t RP, uint8_t GP, uint8_t BP, bool D>
+RotaryEncoder<L, R, P, RP, GP, BP, D>::RotaryEncoder()
+    : EncoderClass(L, R, P, RP, GP, BP, D, false, WriteLEDs<RP != 255, GP != 255, BP != 255>) {
+  /*!
+    @brief   Class constructor
+    @details Sets up the encoder with the EncoderClass constructor, without the registry
+             trampolines, and then attaches the trampolines of this template instance. If the
+             registry is full no interrupts are attached, just as with EncoderClass.
+  */
+  static_assert(L != R && L != P && R != P, "The encoder and pushbutton pins must be different");
+  #if defined(__AVR__)
+  static_assert(digitalPinToInterrupt(L) != NOT_AN_INTERRUPT, "Left pin has no interrupt");
+  static_assert(digitalPinToInterrupt(R) != NOT_AN_INTERRUPT, "Right pin has no interrupt");
+  #endif
+  if (_Slot == ROTARY_MAX_ENCODERS) return;  // Registry full, instance stays inactive
+  _Self      = this;
+  _RotateISR = RotateISR;      // Attach the trampolines of
+  _PushISR   = PushButtonISR;  // this template instance
+  AttachPins();
+}  // of class constructor
+template <uint8_t L, uint8_t R, uint8_t P, uint8_t RP, uint8_t GP, uint8_t BP, bool D>
+RotaryEncoder<L, R, P, RP, GP, BP, D>::~RotaryEncoder() {
+  /*!
+    @brief   Class destructor
+    @details Detaches the interrupts before the instance pointer is cleared, the EncoderClass
+             destructor then frees the registry slot
+  */
+  if (_Self != this) return;  // Nothing to do if never attached
+  DetachPins();
+  _Self = nullptr;
+}  // of class destructor
+  #if defined(ROTARY_STATIC_PINS)
+template <uint8_t L, uint8_t R, uint8_t P, uint8_t RP, uint8_t GP, uint8_t BP, bool D>
+template <uint8_t Pin>
+uint8_t RotaryEncoder<L, R, P, RP, GP, BP, D>::ReadPin() {
+  /*!
+    @brief   Read a pin using its compile-time PINx register and bit
+    @details The port and bit are taken from the pin change interrupt macros of the variant, which
+             are constant expressions. On the ATmega328P and ATmega168 pin change interrupt 0 is on
+             port B, 1 on port C and 2 on port D, and the mask bit of a pin is its bit in the port.
+             The compiler reduces this to a single bit test of the I/O register.
+    @return  Nonzero if the pin is high
+  */
+  static_assert(Pin < NUM_DIGITAL_PINS, "Pin isn't a digital pin of this board");
+  static_assert(digitalPinToPCICRbit(Pin) <= 2, "Pin isn't on port B, C or D");
+  return digitalPinToPCICRbit(Pin) == 0   ? (PINB & _BV(digitalPinToPCMSKbit(Pin) & 7))
+         : digitalPinToPCICRbit(Pin) == 1 ? (PINC & _BV(digitalPinToPCMSKbit(Pin) & 7))
+                                          : (PIND & _BV(digitalPinToPCMSKbit(Pin) & 7));
+}  // of method ReadPin()
+  #endif
+template <uint8_t L, uint8_t R, uint8_t P, uint8_t RP, uint8_t GP, uint8_t BP, bool D>
+void ROTARY_IRAM RotaryEncoder<L, R, P, RP, GP, BP, D>::RotateISR() {
+  /*!
+    @brief   Interrupt trampoline for the left and right pins
+    @details Reads the two pins and passes them to the shared quadrature decoder
+  */
+  #if defined(ROTARY_STATIC_PINS)
+  _Self->RotateStep((ReadPin<L>() ? 0b10 : 0) | (ReadPin<R>() ? 0b01 : 0));
+  #else
+  _Self->RotateHandler();  // Read the pins with the addresses looked up by the constructor
+  #endif
+}  // of method RotateISR()
+template <uint8_t L, uint8_t R, uint8_t P, uint8_t RP, uint8_t GP, uint8_t BP, bool D>
+void ROTARY_IRAM RotaryEncoder<L, R, P, RP, GP, BP, D>::PushButtonISR() {
+  /*!
+    @brief   Interrupt trampoline for the pushbutton pin
+  */
+  _Self->PushButtonHandler();
+}  // of method PushButtonISR()
+#endif